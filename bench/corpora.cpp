@@ -0,0 +1,110 @@
+#include "corpora.hpp"
+
+#include <iterator>
+
+std::string make_identifier_corpus(size_t size) {
+    static const char* const words[] = {
+        "account_balance", "and", "index", "or", "not", "total_count", "x",
+        "nil", "true", "false", "make_adder", "nothing", "android", "truest"
+    };
+    std::string corpus;
+    corpus.reserve(size + 64);
+    for (size_t i = 0; corpus.size() < size; i++) {
+        corpus += words[i % std::size(words)];
+        corpus += i % 8 == 7 ? '\n' : ' ';
+    }
+    return corpus;
+}
+
+std::string make_operator_corpus(size_t size) {
+    static const char* const lines[] = {
+        "(a + b) * [c, d] == {e} /= f <= g >= h .. i\n",
+        "\\x { x ^ 2 - -x / (x < y) : z > w . v = u }\n"
+    };
+    std::string corpus;
+    corpus.reserve(size + 64);
+    for (size_t i = 0; corpus.size() < size; i++) corpus += lines[i % std::size(lines)];
+    return corpus;
+}
+
+std::string make_number_corpus(size_t size) {
+    static const char* const numbers[] = {
+        "0", "12", "3.5", "1024", "0.0125", "98.6", "273.15", "6.02214076", "1000000", "0.5"
+    };
+    std::string corpus = "[";
+    corpus.reserve(size + 64);
+    for (size_t i = 0; corpus.size() < size; i++) {
+        corpus += numbers[i % std::size(numbers)];
+        corpus += i % 16 == 15 ? ",\n" : ", ";
+    }
+    corpus += "0]";
+    return corpus;
+}
+
+std::string make_expression_corpus(size_t size) {
+    static const char* const lines[] = {
+        "account_balance * 3 + total_count / (index - 1)\n",
+        "-price * quantity >= budget - 12.5\n",
+        "[width * height, not visible, (x - y) * (x + y)]\n",
+        "rate / 100 * principal == interest\n"
+    };
+    std::string corpus;
+    corpus.reserve(size + 64);
+    for (size_t i = 0; corpus.size() < size; i++) corpus += lines[i % std::size(lines)];
+    return corpus;
+}
+
+std::string make_string_corpus(size_t size) {
+    static const std::string sentence = "the quick brown fox jumps over the lazy dog ";
+    std::string corpus;
+    corpus.reserve(size + 1024);
+    for (size_t i = 0; corpus.size() < size; i++) {
+        corpus += '"';
+        for (size_t j = 0; j < 4 + i % 8; j++) {
+            corpus += sentence;
+            if (i % 3 == 0 && j == 2) corpus += '\n';
+        }
+        corpus += "\"\n";
+    }
+    return corpus;
+}
+
+std::string make_nested_corpus(size_t size, size_t depth) {
+    std::string expression;
+    for (size_t i = 0; i < depth; i++) expression += i % 2 == 0 ? "(1 + " : "[";
+    expression += "x";
+    for (size_t i = depth; i-- > 0;) expression += i % 2 == 0 ? ")" : "]";
+    expression += '\n';
+    std::string corpus;
+    corpus.reserve(size + expression.size());
+    while (corpus.size() < size) corpus += expression;
+    return corpus;
+}
+
+std::string make_comment_corpus(size_t size) {
+    std::string corpus;
+    corpus.reserve(size + 1024);
+    for (size_t i = 0; corpus.size() < size; i++) {
+        for (size_t line = 0; line < 16; line++) {
+            corpus += "# Comments like this one are skipped with a single scan for the next newline\n";
+        }
+        corpus += "total + " + std::to_string(i) + "\n";
+    }
+    return corpus;
+}
+
+std::string make_repetitive_corpus(size_t size) {
+    static const char* const lines[] = {
+        "scale * (origin_x + 0.5) - scale * (origin_y + 0.5) + ",
+        "[scale * (origin_x + 0.5), scale * (origin_y + 0.5), not visible] .. ",
+        "(width - margin * 2) / (height - margin * 2) < ",
+        "-(scale * (origin_x + 0.5)) ^ 2 + (width - margin * 2) == "
+    };
+    std::string corpus;
+    corpus.reserve(size + 128);
+    for (size_t i = 0; corpus.size() < size; i++) {
+        corpus += lines[i % std::size(lines)];
+        corpus += std::to_string(i % 1000) + "\n";
+    }
+    return corpus;
+}
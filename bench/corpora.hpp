@@ -0,0 +1,37 @@
+#ifndef PIEROGI_BENCH_CORPORA_HPP
+#define PIEROGI_BENCH_CORPORA_HPP
+
+#include <string>
+
+// Synthetic sources for the benchmarks. Each generator produces roughly
+// `size` bytes, stopping at the end of whatever it was in the middle of.
+
+// Definitions that are almost entirely identifiers and keywords, so that word
+// classification dominates the lexing time
+std::string make_identifier_corpus(size_t size);
+
+// Expressions that are mostly operators and brackets
+std::string make_operator_corpus(size_t size);
+
+// One big list literal full of measurements
+std::string make_number_corpus(size_t size);
+
+// Arithmetic and comparisons over identifiers and numbers, using only what
+// the parser understands
+std::string make_expression_corpus(size_t size);
+
+// String literals of a few hundred bytes each, some of them spanning lines
+std::string make_string_corpus(size_t size);
+
+// Expressions nested `depth` brackets deep, alternating between groups and
+// lists
+std::string make_nested_corpus(size_t size, size_t depth);
+
+// Long blocks of comments with an expression between each
+std::string make_comment_corpus(size_t size);
+
+// Generated-looking code that keeps repeating the same few subexpressions,
+// with a different index at the end of each line
+std::string make_repetitive_corpus(size_t size);
+
+#endif // PIEROGI_BENCH_CORPORA_HPP
@@ -0,0 +1,69 @@
+#include "lexer.hpp"
+#include "errors.hpp"
+#include "corpora.hpp"
+#include "throughput.hpp"
+
+#include "third-party/catch.hpp"
+
+#include <string>
+
+using namespace pierogi;
+
+class dummy_reporter : public errors::reporter_interface {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+    void report(errors::error_type type, std::string_view message, int line, int column) override {
+        // Do nothing
+    }
+#pragma GCC diagnostic pop
+};
+
+static auto error_ignorer = dummy_reporter();
+
+void benchmark_tokenize(const std::string& name, const std::string& corpus,
+                        lexer::dispatch strategy = lexer::dispatch::TABLE) {
+    size_t token_count = lexer::tokenize(corpus, error_ignorer, strategy).size();
+    benchmark_throughput(name, corpus.size(), token_count, [&] {
+        return lexer::tokenize(corpus, error_ignorer, strategy);
+    });
+}
+
+TEST_CASE("Lex identifier-heavy source") {
+    benchmark_tokenize("tokenize 1 MiB of identifiers", make_identifier_corpus(1 << 20));
+}
+
+TEST_CASE("Lex operator-heavy source") {
+    const std::string corpus = make_operator_corpus(1 << 20);
+    benchmark_tokenize("tokenize 1 MiB of operators with switch dispatch", corpus, lexer::dispatch::SWITCH);
+    benchmark_tokenize("tokenize 1 MiB of operators with table dispatch", corpus, lexer::dispatch::TABLE);
+}
+
+TEST_CASE("Lex number-heavy source") {
+    benchmark_tokenize("tokenize 1 MiB of number literals", make_number_corpus(1 << 20));
+}
+
+TEST_CASE("Lex long strings") {
+    benchmark_tokenize("tokenize 1 MiB of string literals", make_string_corpus(1 << 20));
+}
+
+TEST_CASE("Lex deeply nested source") {
+    benchmark_tokenize("tokenize 1 MiB nested 256 deep", make_nested_corpus(1 << 20, 256));
+}
+
+TEST_CASE("Lex long comment blocks") {
+    benchmark_tokenize("tokenize 1 MiB of comments", make_comment_corpus(1 << 20));
+}
+
+TEST_CASE("Lex a large source in parallel") {
+    const std::string corpus = make_identifier_corpus(4 << 20) + make_number_corpus(4 << 20);
+    size_t token_count = lexer::tokenize(corpus, error_ignorer).size();
+    benchmark_tokenize("tokenize 8 MiB serially", corpus);
+    for (size_t thread_count : {1, 2, 4, 8}) {
+        lexer::parallel_options options;
+        options.thread_count = thread_count;
+        benchmark_throughput("tokenize 8 MiB on " + std::to_string(thread_count) + " threads",
+                             corpus.size(), token_count, [&] {
+            return lexer::tokenize_parallel(corpus, error_ignorer, options);
+        });
+    }
+}
@@ -0,0 +1,126 @@
+#include "parser.hpp"
+#include "lexer.hpp"
+#include "errors.hpp"
+#include "corpora.hpp"
+#include "throughput.hpp"
+
+#include "third-party/catch.hpp"
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <string>
+
+using namespace pierogi;
+
+class dummy_reporter : public errors::reporter_interface {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+    void report(errors::error_type type, std::string_view message, int line, int column) override {
+        // Do nothing
+    }
+#pragma GCC diagnostic pop
+};
+
+static auto error_ignorer = dummy_reporter();
+
+// Benchmarks parsing tokens that were lexed up front, then lexing and parsing
+// together. Both include tearing the tree down again.
+void benchmark_create_ast(const std::string& name, const std::string& corpus) {
+    auto tokens = lexer::tokenize(corpus, error_ignorer);
+    benchmark_throughput("parse " + name, corpus.size(), tokens.size(), [&] {
+        return parser::create_ast(tokens, error_ignorer);
+    });
+    benchmark_throughput("tokenize and parse " + name, corpus.size(), tokens.size(), [&] {
+        return parser::create_ast(lexer::tokenize(corpus, error_ignorer), error_ignorer);
+    });
+    benchmark_throughput("parse " + name + " into the flat AST", corpus.size(), tokens.size(), [&] {
+        return parser::create_flat_ast(tokens, error_ignorer);
+    });
+}
+
+TEST_CASE("Parse identifier-heavy expressions") {
+    benchmark_create_ast("1 MiB of expressions", make_expression_corpus(1 << 20));
+}
+
+TEST_CASE("Parse number-heavy source") {
+    benchmark_create_ast("1 MiB of number literals", make_number_corpus(1 << 20));
+}
+
+TEST_CASE("Parse long strings") {
+    benchmark_create_ast("1 MiB of string literals", make_string_corpus(1 << 20));
+}
+
+TEST_CASE("Parse deeply nested source") {
+    benchmark_create_ast("1 MiB nested 256 deep", make_nested_corpus(1 << 20, 256));
+}
+
+TEST_CASE("Parse a single expression nested a million deep") {
+    benchmark_create_ast("1 expression nested 1M deep", make_nested_corpus(1, 1 << 20));
+}
+
+TEST_CASE("Parse source with long comment blocks") {
+    benchmark_create_ast("1 MiB of comments", make_comment_corpus(1 << 20));
+}
+
+TEST_CASE("Parse one big list on several threads") {
+    const std::string corpus = make_number_corpus(1 << 20);
+    auto tokens = lexer::tokenize(corpus, error_ignorer);
+    for (size_t thread_count : {1, 2, 4, 8}) {
+        parser::parse_options options;
+        options.thread_count = thread_count;
+        // Otherwise the list would be folded into a constant
+        options.fold_literal_lists = false;
+        benchmark_throughput("parse a 1 MiB list on " + std::to_string(thread_count) + " threads",
+                             corpus.size(), tokens.size(), [&] {
+            return parser::create_ast(tokens, error_ignorer, options);
+        });
+    }
+}
+
+// Catch would have to parse a new tree for every run it times, so tearing
+// trees down is timed by hand instead
+TEST_CASE("Tear down a large tree") {
+    const std::string corpus = make_expression_corpus(1 << 20);
+    auto tokens = lexer::tokenize(corpus, error_ignorer);
+    using clock = std::chrono::steady_clock;
+    std::chrono::duration<double, std::milli> parsing{}, teardown{};
+    const int runs = 5;
+    for (int i = 0; i < runs; i++) {
+        auto start = clock::now();
+        std::optional<ast::module> module = parser::create_ast(tokens, error_ignorer);
+        auto parsed = clock::now();
+        module.reset();
+        teardown += clock::now() - parsed;
+        parsing += parsed - start;
+    }
+    std::cout << std::fixed << std::setprecision(2) << "\nparse 1 MiB of expressions: "
+              << parsing.count() / runs << " ms, then tear it down: " << teardown.count() / runs << " ms\n";
+}
+
+// Also reports how much memory the nodes take, so sharing them is timed by
+// hand too
+TEST_CASE("Share identical subtrees of repetitive source") {
+    const std::string corpus = make_repetitive_corpus(1 << 20);
+    auto tokens = lexer::tokenize(corpus, error_ignorer);
+    using clock = std::chrono::steady_clock;
+    const int runs = 5;
+    for (bool share : {false, true}) {
+        parser::parse_options options;
+        options.share_identical_subtrees = share;
+        std::chrono::duration<double, std::milli> parsing{};
+        size_t arena_bytes = 0;
+        size_t flat_nodes = 0;
+        for (int i = 0; i < runs; i++) {
+            auto start = clock::now();
+            auto module = parser::create_ast(tokens, error_ignorer, options);
+            parsing += clock::now() - start;
+            arena_bytes = module.nodes->bytes_used();
+        }
+        flat_nodes = parser::create_flat_ast(tokens, error_ignorer, options).nodes.size();
+        std::cout << std::fixed << std::setprecision(2) << "\nparse 1 MiB of repetitive source"
+                  << (share ? " sharing subtrees: " : ": ") << parsing.count() / runs << " ms, "
+                  << arena_bytes / 1024 << " KiB of nodes, " << flat_nodes << " flat nodes\n";
+    }
+}
@@ -0,0 +1,35 @@
+#ifndef PIEROGI_BENCH_THROUGHPUT_HPP
+#define PIEROGI_BENCH_THROUGHPUT_HPP
+
+#include "third-party/catch.hpp"
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+// Catch only reports the time taken per run, so after benchmarking `run` this
+// times it again for long enough to print its throughput in bytes and tokens
+// per second
+template <typename TRun>
+void benchmark_throughput(const std::string& name, size_t bytes, size_t tokens, TRun run) {
+    BENCHMARK(std::string(name)) {
+        return run();
+    };
+    using clock = std::chrono::steady_clock;
+    size_t runs = 0;
+    auto start = clock::now();
+    std::chrono::duration<double> elapsed{};
+    while (elapsed < std::chrono::milliseconds(250)) {
+        auto result = run();
+        Catch::Benchmark::deoptimize_value(result);
+        runs++;
+        elapsed = clock::now() - start;
+    }
+    double seconds_per_run = elapsed.count() / static_cast<double>(runs);
+    std::cout << std::fixed << std::setprecision(1) << '\n' << name << ": "
+              << static_cast<double>(bytes) / seconds_per_run / 1e6 << " MB/s, "
+              << static_cast<double>(tokens) / seconds_per_run / 1e6 << " Mtokens/s\n";
+}
+
+#endif // PIEROGI_BENCH_THROUGHPUT_HPP
@@ -0,0 +1,133 @@
+#ifndef PIEROGI_ARENA_HPP
+#define PIEROGI_ARENA_HPP
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace pierogi::arena {
+
+// A view of a run of objects stored contiguously in an arena
+template <typename T>
+class span {
+public:
+    span() = default;
+    span(T* first, size_t count) : first(first), count(count) {}
+
+    [[nodiscard]] T* begin() const {
+        return first;
+    }
+
+    [[nodiscard]] T* end() const {
+        return first + count;
+    }
+
+    [[nodiscard]] size_t size() const {
+        return count;
+    }
+
+    [[nodiscard]] bool empty() const {
+        return count == 0;
+    }
+
+    T& operator[](size_t index) const {
+        return first[index];
+    }
+
+    [[nodiscard]] T& front() const {
+        return first[0];
+    }
+
+    [[nodiscard]] T& back() const {
+        return first[count - 1];
+    }
+
+private:
+    T* first = nullptr;
+    size_t count = 0;
+};
+
+// Hands out memory by bumping a pointer through large blocks, and frees all
+// of it at once when destroyed. Objects that need their destructors run are
+// remembered and destroyed first, in the reverse of the order they were
+// created; trivially destructible ones cost nothing to tear down.
+class bump_arena {
+public:
+    bump_arena() = default;
+    ~bump_arena();
+
+    bump_arena(const bump_arena&) = delete;
+    bump_arena& operator=(const bump_arena&) = delete;
+
+    // `alignment` can be at most alignof(std::max_align_t)
+    void* allocate(size_t size, size_t alignment);
+
+    template <typename T, typename... TArgs>
+    T* create(TArgs&&... args) {
+        T* object = new (allocate(sizeof(T), alignof(T))) T(std::forward<TArgs>(args)...);
+        if constexpr (!std::is_trivially_destructible_v<T>) {
+            destructors.push_back({[](void* o) { static_cast<T*>(o)->~T(); }, object});
+        }
+        return object;
+    }
+
+    // Copies [first, last) into the arena
+    template <typename T, typename TIterator>
+    span<T> copy(TIterator first, TIterator last) {
+        auto count = static_cast<size_t>(std::distance(first, last));
+        if (count == 0) return {};
+        T* copies = static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+        for (size_t i = 0; i < count; i++, ++first) {
+            T* copy = new (copies + i) T(*first);
+            if constexpr (!std::is_trivially_destructible_v<T>) {
+                destructors.push_back({[](void* o) { static_cast<T*>(o)->~T(); }, copy});
+            }
+        }
+        return {copies, count};
+    }
+
+    // Makes room for `count` value-initialized objects in one allocation
+    template <typename T>
+    span<T> create_array(size_t count) {
+        if (count == 0) return {};
+        T* objects = static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+        for (size_t i = 0; i < count; i++) {
+            T* object = new (objects + i) T();
+            if constexpr (!std::is_trivially_destructible_v<T>) {
+                destructors.push_back({[](void* o) { static_cast<T*>(o)->~T(); }, object});
+            }
+        }
+        return {objects, count};
+    }
+
+    // Takes over everything `other` has allocated, which then lives as long
+    // as this arena does. Objects in it stay where they are. `other` is left
+    // empty.
+    void adopt(bump_arena&& other);
+
+    // Bytes handed out so far, not counting the unused ends of blocks
+    [[nodiscard]] size_t bytes_used() const {
+        return used;
+    }
+
+private:
+    static constexpr size_t block_size = 1 << 16;
+
+    struct destructor {
+        void (*destroy)(void*);
+        void* object;
+    };
+
+    std::vector<std::unique_ptr<std::byte[]>> blocks;
+    std::byte* cursor = nullptr;
+    std::byte* limit = nullptr;
+    size_t used = 0;
+    std::vector<destructor> destructors;
+};
+
+} // namespace pierogi::arena
+
+#endif // PIEROGI_ARENA_HPP
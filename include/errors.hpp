@@ -1,25 +1,92 @@
 #ifndef PIEROGI_ERRORS_HPP
 #define PIEROGI_ERRORS_HPP
 
-#include <string>
-#include <unordered_map>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string_view>
 
 namespace pierogi::errors {
 
 enum class error_type {
     UNRECOGNIZED_CHARACTER,
-    UNTERMINATED_STRING
+    UNTERMINATED_STRING,
+    INVALID_UTF8,
+    UNEXPECTED_TOKEN,
+    NESTING_TOO_DEEP
 };
 
+// A short description of the error, without any location
+std::string_view message(error_type type);
+
 class reporter_interface {
 public:
-    virtual void report(error_type type, const std::string& near_lexeme, int line) = 0;
+    // Lines and columns count from 1. `near_lexeme` is only valid for the
+    // duration of the call.
+    virtual void report(error_type type, std::string_view near_lexeme, int line, int column) = 0;
 };
 
 // TODO: Move this class up to the interpreter's level
 class console_reporter : public reporter_interface {
 public:
-	void report(error_type type, const std::string& near_lexeme, int line) override;
+	void report(error_type type, std::string_view near_lexeme, int line, int column) override;
+};
+
+// An error as the lexer first sees it: the bytes of the source it's about
+struct diagnostic {
+    error_type type;
+    uint32_t offset;
+    uint32_t length;
+};
+
+// Collects errors as compact records in space set aside up front, so that
+// recording one never allocates, and only turns them into messages when
+// flushed. Any number of threads may record into the same buffer at once.
+// Once `limit` errors have been recorded the buffer is full, and the lexer
+// stops at that point rather than keep going through a corrupted source.
+class diagnostics {
+public:
+    explicit diagnostics(size_t limit);
+
+    diagnostics(const diagnostics&) = delete;
+    diagnostics& operator=(const diagnostics&) = delete;
+
+    // Returns false once the buffer is full, whether or not this error fit
+    bool record(error_type type, size_t offset, size_t length);
+
+    [[nodiscard]] bool full() const {
+        return count.load(std::memory_order_relaxed) >= limit;
+    }
+
+    [[nodiscard]] size_t size() const {
+        return std::min(count.load(std::memory_order_relaxed), limit);
+    }
+
+    // The rest may only be used while no thread is recording
+
+    // Records in the order they were recorded, which is only the order of
+    // their offsets if a single thread recorded them
+    [[nodiscard]] const diagnostic* begin() const {
+        return slots.get();
+    }
+
+    [[nodiscard]] const diagnostic* end() const {
+        return slots.get() + size();
+    }
+
+    // Reports every record, in the order of their offsets into `source`, and
+    // empties the buffer
+    void flush(std::string_view source, reporter_interface& reporter);
+
+    void clear() {
+        count.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    std::unique_ptr<diagnostic[]> slots;
+    size_t limit;
+    std::atomic<size_t> count = 0;
 };
 
 } // namespace pierogi::errors
@@ -3,14 +3,20 @@
 
 #include "types.hpp"
 #include "errors.hpp"
+#include "source.hpp"
+#include "symbols.hpp"
 
+#include <cstdint>
+#include <iterator>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <variant>
 
 namespace pierogi::lexer {
 
-enum class token_type {
+enum class token_type : uint8_t {
 	LEFT_PARENTHESIS,
 	RIGHT_PARENTHESIS,
 	LEFT_SQUARE_BRACKET,
@@ -50,17 +56,252 @@ enum class token_type {
     EOF_
 };
 
+// Lexemes are views into the source that was tokenized rather than copies of
+// it, so a token must not outlive that source. Tokens only record where they
+// start; source::line_index turns that into a line and column when needed.
+// The values of literals aren't decoded until decode_number() or
+// decode_string() asks for them.
 struct token {
 	token_type type;
-	std::string lexeme;
-	types::value value;
-	int line;
+	std::string_view lexeme;
+	uint32_t offset;
+	// The interned name of an IDENTIFIER token, and 0 for any other token
+	symbols::symbol_id symbol;
 
-	token(token_type type, std::string lexeme, types::value value, int line);
+	token(token_type type, std::string_view lexeme, uint32_t offset, symbols::symbol_id symbol = 0);
 };
 
-std::vector<token> tokenize(const std::string& source,
-							errors::reporter_interface& error_reporter);
+// Tokens stored as parallel arrays: a 1-byte type, a 32-bit source offset and
+// a 32-bit length per token. The symbol ids of IDENTIFIER tokens live in a
+// side table that only has entries for those tokens. Tokens are handed out as
+// `token` views built on the fly, but the parser reads the arrays directly.
+// Sources must be smaller than 4 GiB.
+//
+// Brackets are paired up as tokens are added, so that anything reading the
+// buffer can jump from a bracket to its partner without parsing what's in
+// between. A closing bracket only pairs with the innermost bracket still open,
+// and only if they're the same kind.
+class token_buffer {
+public:
+	class const_iterator {
+	public:
+		using iterator_category = std::input_iterator_tag;
+		using value_type = token;
+		using difference_type = std::ptrdiff_t;
+		using pointer = void;
+		using reference = token;
+
+		const_iterator(const token_buffer& buffer, size_t index) : buffer(&buffer), index(index) {}
+
+		token operator*() const { return (*buffer)[index]; }
+		const_iterator& operator++() { index++; return *this; }
+		bool operator==(const const_iterator& other) const { return index == other.index; }
+		bool operator!=(const const_iterator& other) const { return index != other.index; }
+
+	private:
+		const token_buffer* buffer;
+		size_t index;
+	};
+
+	token_buffer() = default;
+	token_buffer(std::string_view source, std::shared_ptr<symbols::symbol_table> symbols)
+		: source_text(source), symbol_names(std::move(symbols)) {}
+
+	[[nodiscard]] std::string_view source() const { return source_text; }
+	// The table this buffer's identifiers were interned into
+	[[nodiscard]] const std::shared_ptr<symbols::symbol_table>& symbols() const { return symbol_names; }
+	[[nodiscard]] size_t size() const { return types.size(); }
+	[[nodiscard]] bool empty() const { return types.empty(); }
+
+	[[nodiscard]] token_type type(size_t index) const { return types[index]; }
+	[[nodiscard]] uint32_t offset(size_t index) const { return offsets[index]; }
+	[[nodiscard]] uint32_t length(size_t index) const { return lengths[index]; }
+	[[nodiscard]] std::string_view lexeme(size_t index) const {
+		return source_text.substr(offsets[index], lengths[index]);
+	}
+
+	// The interned name of an IDENTIFIER token
+	[[nodiscard]] symbols::symbol_id symbol(size_t index) const;
+
+	static constexpr uint32_t no_partner = UINT32_MAX;
+
+	// For an opening bracket, the index of the bracket that closes it, and for
+	// a closing bracket, the index of the one it closes. Any other token, or a
+	// bracket without a partner, has no_partner.
+	[[nodiscard]] uint32_t partner(size_t index) const { return partners[index]; }
+
+	[[nodiscard]] token operator[](size_t index) const;
+	[[nodiscard]] token front() const { return (*this)[0]; }
+	[[nodiscard]] token back() const { return (*this)[size() - 1]; }
+	[[nodiscard]] const_iterator begin() const { return {*this, 0}; }
+	[[nodiscard]] const_iterator end() const { return {*this, size()}; }
+
+	void push_back(token_type type, size_t offset, size_t length);
+	void push_identifier(symbols::symbol_id symbol, size_t offset, size_t length);
+	// Appends tokens [first, last) of `other`, which must view the same source
+	// and intern into the same symbol table
+	void append(const token_buffer& other, size_t first, size_t last);
+	// Replaces tokens [first, last) with all of `replacement`'s tokens and adds
+	// `offset_shift` to the offsets of the tokens after them. The buffer then
+	// views `replacement`'s source. Tokens outside the range stay where they are.
+	// Brackets are paired again from the edit on, until they pair up the way
+	// they did before.
+	void replace(size_t first, size_t last, const token_buffer& replacement, std::ptrdiff_t offset_shift);
+	void reserve(size_t token_count);
+	void clear();
+
+private:
+	std::string_view source_text;
+	std::shared_ptr<symbols::symbol_table> symbol_names;
+	std::vector<token_type> types;
+	std::vector<uint32_t> offsets;
+	std::vector<uint32_t> lengths;
+	// Sorted by token index, so a token's entry is found by binary search
+	std::vector<uint32_t> symbol_indices;
+	std::vector<symbols::symbol_id> symbol_ids;
+	std::vector<uint32_t> partners;
+	// Opening brackets nothing has closed yet, innermost last
+	std::vector<uint32_t> open_brackets;
+
+	// Pairs up the token at `index`, which was just added, if it's a bracket
+	void match_bracket(size_t index);
+};
+
+// How the lexer picks apart each token: with a hand-written switch, or with a
+// character class table and an operator automaton generated at compile time.
+// Both produce identical tokens.
+enum class dispatch {
+	SWITCH,
+	TABLE
+};
+
+// The caller owns `source` and must keep it alive for as long as the returned
+// tokens are in use. Identifiers are interned into a new symbol table, which
+// the returned buffer shares ownership of.
+token_buffer tokenize(std::string_view source,
+					  errors::reporter_interface& error_reporter,
+					  dispatch strategy = dispatch::TABLE);
+
+// Records errors in `diagnostics` instead of reporting them. If the buffer
+// fills up, lexing stops there and the returned tokens end early with EOF.
+token_buffer tokenize(std::string_view source,
+					  errors::diagnostics& diagnostics,
+					  dispatch strategy = dispatch::TABLE);
+
+struct parallel_options {
+	// Zero means one thread per hardware thread
+	size_t thread_count = 0;
+	// Sources too small to give every thread a chunk this big use fewer threads
+	size_t min_chunk_size = 1 << 20;
+	dispatch strategy = dispatch::TABLE;
+};
+
+// Splits the source into chunks at line boundaries and lexes them on separate
+// threads, then stitches the results together. The tokens and errors are
+// exactly those tokenize() would produce, in the same order, except that
+// symbol ids depend on which thread interned each name first.
+token_buffer tokenize_parallel(std::string_view source,
+							   errors::reporter_interface& error_reporter,
+							   const parallel_options& options = {});
+
+token_buffer tokenize_parallel(std::string_view source,
+							   errors::diagnostics& diagnostics,
+							   const parallel_options& options = {});
+
+// Tokens lexed straight out of a memory-mapped file, together with the
+// mapping their lexemes point into. Share `source` with anything that keeps
+// tokens (or views of them) beyond the lifetime of this struct.
+struct file_tokens {
+	std::shared_ptr<const source::mapped_file> source;
+	token_buffer tokens;
+};
+
+// Throws std::system_error if the file can't be opened or mapped
+file_tokens tokenize_file(const std::filesystem::path& path,
+						  errors::reporter_interface& error_reporter,
+						  dispatch strategy = dispatch::TABLE);
+
+// A change to a source: the `removed_length` bytes starting at `offset` were
+// replaced by `inserted_length` new ones
+struct edit {
+	size_t offset;
+	size_t removed_length;
+	size_t inserted_length;
+};
+
+// Updates `tokens`, lexed from some earlier source, to match `new_source`,
+// which is that source with `change` applied. Lexing restarts at the last
+// token boundary the edit can't affect and stops as soon as it lines up with
+// a token from after the edit again; everything else stays where it is in
+// the buffer, with the tokens after the edit only having their offsets
+// shifted. Errors are only reported for the stretch that was lexed again.
+void relex(token_buffer& tokens,
+		   std::string_view new_source,
+		   const edit& change,
+		   errors::reporter_interface& error_reporter,
+		   dispatch strategy = dispatch::TABLE);
+
+// If `diagnostics` fills up, every token from where it did is dropped
+void relex(token_buffer& tokens,
+		   std::string_view new_source,
+		   const edit& change,
+		   errors::diagnostics& diagnostics,
+		   dispatch strategy = dispatch::TABLE);
+
+struct state;
+
+// Lexes tokens only as they're asked for, keeping just the previous token and
+// a bounded window of lookahead instead of the whole token list. Like
+// tokenize(), the caller must keep `source` alive while the stream is in use.
+class token_stream {
+public:
+	static constexpr size_t max_lookahead = 4;
+
+	token_stream(std::string_view source,
+				 errors::reporter_interface& error_reporter,
+				 dispatch strategy = dispatch::TABLE);
+	// If `diagnostics` fills up, the stream ends early with EOF there
+	token_stream(std::string_view source,
+				 errors::diagnostics& diagnostics,
+				 dispatch strategy = dispatch::TABLE);
+	~token_stream();
+
+	// The token `distance` places past the current one, where `distance` is
+	// less than max_lookahead; any further would overwrite previous(). Past
+	// the end of the source, this is EOF.
+	const token& peek(size_t distance = 0);
+
+	// The token most recently advanced past. Only valid after advance().
+	[[nodiscard]] const token& previous() const;
+
+	void advance();
+
+	// The table the stream's identifiers are interned into
+	[[nodiscard]] const std::shared_ptr<symbols::symbol_table>& symbols() const;
+
+	[[nodiscard]] std::string_view source() const;
+
+private:
+	static constexpr size_t ring_size = max_lookahead + 1;
+
+	token_stream(std::unique_ptr<state> lexer, dispatch strategy);
+
+	std::unique_ptr<state> lexer;
+	dispatch strategy;
+	std::vector<token> ring;
+	size_t current_index = 0, lexed_count = 0;
+};
+
+// Returns the contents of a STRING token without its surrounding quotes. No
+// bytes are copied; the result views the same source as the token's lexeme.
+std::string_view string_contents(const token& string_token);
+
+// The value of a NUMBER token
+types::number decode_number(const token& number_token);
+
+// The value of a STRING token. This is where escape sequences will be
+// processed, so it copies where string_contents() doesn't.
+types::string decode_string(const token& string_token);
 
 } // namespace pierogi::lexer
 
@@ -0,0 +1,18 @@
+#ifndef PIEROGI_NUMBERS_HPP
+#define PIEROGI_NUMBERS_HPP
+
+#include "types.hpp"
+
+#include <string_view>
+
+namespace pierogi::numbers {
+
+// Converts a number literal as recognized by the lexer (one or more digits,
+// optionally followed by '.' and one or more digits) to the nearest
+// types::number, exactly as std::stold would but without allocating or
+// consulting the locale.
+types::number parse_literal(std::string_view literal);
+
+} // namespace pierogi::numbers
+
+#endif // PIEROGI_NUMBERS_HPP
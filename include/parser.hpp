@@ -2,12 +2,58 @@
 #define PIEROGI_PARSER_HPP
 
 #include "generated/ast.hpp"
+#include "generated/flat_ast.hpp"
 #include "lexer.hpp"
 
+#include <cstdint>
+
 namespace pierogi::parser {
 
-std::vector<ast::expression> create_ast(const std::vector<lexer::token>& tokens,
-                                        errors::reporter_interface& error_reporter);
+struct parse_options {
+    // How many constructs can be open around an expression at once, where a
+    // construct is a bracket or parenthesis, a prefix operator, or a binary
+    // operator still waiting for its right-hand side. Source that nests any
+    // deeper gets a NESTING_TOO_DEEP error instead of being parsed.
+    size_t max_depth = SIZE_MAX;
+    // Lists with at least this many tokens between their brackets have their
+    // elements split between threads, when a token buffer is parsed into the
+    // pointer AST. The tree and errors come out the same either way.
+    size_t min_parallel_list_tokens = 1 << 16;
+    // Zero means one thread per hardware thread
+    size_t thread_count = 0;
+    // Lists of nothing but literals become one constant_list node holding
+    // their values, instead of a node per element
+    bool fold_literal_lists = true;
+    // Operators and groups whose operands are all literals are evaluated
+    // while parsing and replaced with the literal they evaluate to. Anything
+    // that could fail or depend on how it's evaluated, like dividing by zero
+    // or comparing values of different types, is left alone.
+    bool fold_constants = false;
+    // A node that would be identical to one made before, down to its
+    // children, is shared instead of made again, so the tree becomes a DAG.
+    // Worth it for generated source that repeats itself. Big lists are then
+    // parsed on one thread.
+    bool share_identical_subtrees = false;
+};
+
+// Every node of the tree is allocated from the returned module's arena
+ast::module create_ast(const lexer::token_buffer& tokens,
+                       errors::reporter_interface& error_reporter,
+                       const parse_options& options = {});
+
+// Parses while the stream lexes, so only a few tokens are ever held at once
+ast::module create_ast(lexer::token_stream& tokens,
+                       errors::reporter_interface& error_reporter,
+                       const parse_options& options = {});
+
+// Parses into the flat AST instead, whose nodes refer to each other by index
+flat_ast::module create_flat_ast(const lexer::token_buffer& tokens,
+                                 errors::reporter_interface& error_reporter,
+                                 const parse_options& options = {});
+
+flat_ast::module create_flat_ast(lexer::token_stream& tokens,
+                                 errors::reporter_interface& error_reporter,
+                                 const parse_options& options = {});
 
 } // namespace pierogi::parser
 
@@ -0,0 +1,49 @@
+#ifndef PIEROGI_SCANNER_HPP
+#define PIEROGI_SCANNER_HPP
+
+#include <vector>
+
+namespace pierogi::scanner {
+
+// Vectorized helpers for the lexer's hot loops. Every scanner takes the
+// half-open range [begin, end) and returns a pointer to the first byte that
+// stops the scan, or `end` if there isn't one.
+
+enum class instruction_set {
+    SCALAR,
+    SSE2,
+    AVX2
+};
+
+struct scanners {
+    // Stops at the first byte that can't continue an identifier
+    const char* (*skip_identifier)(const char* begin, const char* end);
+
+    // Stops at the first byte that isn't ' ', '\t', '\r' or '\n'
+    const char* (*skip_whitespace)(const char* begin, const char* end);
+
+    // Stops at the next '\n'
+    const char* (*find_line_end)(const char* begin, const char* end);
+
+    // Stops at the next '"'
+    const char* (*find_string_end)(const char* begin, const char* end);
+
+    // Stops at the first byte that isn't ASCII
+    const char* (*find_non_ascii)(const char* begin, const char* end);
+
+    // Stops at the start of the first sequence that isn't valid UTF-8. `begin`
+    // must be at the start of a character.
+    const char* (*validate_utf8)(const char* begin, const char* end);
+};
+
+// The fastest implementation supported by the CPU we're running on, picked
+// the first time this is called.
+const scanners& best_scanners();
+
+const scanners& scanners_for(instruction_set set);
+
+std::vector<instruction_set> supported_instruction_sets();
+
+} // namespace pierogi::scanner
+
+#endif // PIEROGI_SCANNER_HPP
@@ -0,0 +1,58 @@
+#ifndef PIEROGI_SOURCE_HPP
+#define PIEROGI_SOURCE_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace pierogi::source {
+
+// A file's contents, mapped read-only into memory where the platform supports
+// it (and read into a string where it doesn't). Views of the contents stay
+// valid for as long as the mapped_file is alive.
+class mapped_file {
+public:
+    // Throws std::system_error if the file can't be opened or mapped
+    explicit mapped_file(const std::filesystem::path& path);
+    ~mapped_file();
+
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+
+    [[nodiscard]] std::string_view contents() const {
+        return {data, size};
+    }
+
+private:
+    const char* data = nullptr;
+    size_t size = 0;
+    std::string fallback_contents;
+};
+
+struct location {
+    int line;
+    int column;
+};
+
+// The offset of every line's first byte, so that a byte offset can be turned
+// into a line and column without the lexer counting newlines as it goes.
+class line_index {
+public:
+    explicit line_index(std::string_view text);
+
+    // Lines and columns count from 1, and columns count bytes
+    [[nodiscard]] location locate(size_t offset) const;
+
+    [[nodiscard]] size_t line_count() const {
+        return line_starts.size();
+    }
+
+private:
+    std::vector<uint32_t> line_starts;
+};
+
+} // namespace pierogi::source
+
+#endif // PIEROGI_SOURCE_HPP
@@ -0,0 +1,50 @@
+#ifndef PIEROGI_SYMBOLS_HPP
+#define PIEROGI_SYMBOLS_HPP
+
+#include <cstdint>
+#include <memory>
+#include <shared_mutex>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace pierogi::symbols {
+
+// Every distinct name interned in a table gets its own id, so two names are
+// equal exactly when their ids are. Ids count up from 0 in the order names
+// were first interned.
+using symbol_id = uint32_t;
+
+// Interns names, copying each distinct one into an arena exactly once. Names
+// handed out by name() stay valid for as long as the table does. Any number
+// of threads may intern and look up names at the same time.
+class symbol_table {
+public:
+    symbol_table() = default;
+
+    symbol_table(const symbol_table&) = delete;
+    symbol_table& operator=(const symbol_table&) = delete;
+
+    symbol_id intern(std::string_view name);
+
+    [[nodiscard]] std::string_view name(symbol_id id) const;
+
+    [[nodiscard]] size_t size() const;
+
+private:
+    static constexpr size_t block_size = 1 << 16;
+
+    // Copies `name` into the arena, starting a new block if the current one
+    // is full. Blocks never move, so the copies never do either.
+    std::string_view store(std::string_view name);
+
+    mutable std::shared_mutex mutex;
+    std::unordered_map<std::string_view, symbol_id> ids;
+    std::vector<std::string_view> names;
+    std::vector<std::unique_ptr<char[]>> blocks;
+    size_t block_used = 0;
+};
+
+} // namespace pierogi::symbols
+
+#endif // PIEROGI_SYMBOLS_HPP
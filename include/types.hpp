@@ -23,12 +23,26 @@ class list;
 using value = std::variant<nil_type, number, string, boolean, list>;
 
 class list {
-    std::forward_list<value> contents;
+    // Lists of nothing but numbers keep them packed in one array
+    std::variant<std::forward_list<value>, std::vector<number>> contents;
 public:
-    explicit list(const std::vector<value>& contents) {
-        this->contents.assign(contents.begin(), contents.end());
+    explicit list(const std::vector<value>& contents);
+    list(std::initializer_list<value>&& contents);
+    explicit list(std::vector<number> numbers) : contents(std::move(numbers)) {}
+
+    [[nodiscard]] bool packed() const {
+        return std::holds_alternative<std::vector<number>>(contents);
+    }
+
+    // The elements of a packed list
+    [[nodiscard]] const std::vector<number>& numbers() const {
+        return std::get<std::vector<number>>(contents);
     }
-    list(std::initializer_list<value>&& contents) : contents(contents) {}
+
+    [[nodiscard]] size_t size() const;
+
+    // Every element, unpacking them if need be
+    [[nodiscard]] std::vector<value> elements() const;
 };
 
 } // namespace pierogi::types
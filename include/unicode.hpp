@@ -0,0 +1,26 @@
+#ifndef PIEROGI_UNICODE_HPP
+#define PIEROGI_UNICODE_HPP
+
+#include <cstddef>
+
+namespace pierogi::unicode {
+
+struct decoded_code_point {
+    char32_t code_point;
+    // Zero if the bytes weren't a valid UTF-8 sequence
+    size_t length;
+};
+
+// Decodes the UTF-8 sequence at the start of [begin, end), rejecting overlong
+// encodings, surrogates and anything past U+10FFFF. `begin` must be before
+// `end`.
+decoded_code_point decode(const char* begin, const char* end);
+
+// Whether a code point may appear in an identifier. This covers the letters
+// of the Latin, Greek, Cyrillic, Armenian, Hebrew, Arabic, Devanagari, Thai,
+// Georgian, Hangul, kana and CJK blocks rather than all of Unicode's letters.
+bool is_letter(char32_t code_point);
+
+} // namespace pierogi::unicode
+
+#endif // PIEROGI_UNICODE_HPP
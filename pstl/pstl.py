@@ -11,6 +11,8 @@ HEADER_TEMPLATE = """\
 #ifndef PIEROGI_AST_HPP
 #define PIEROGI_AST_HPP
 
+#include "arena.hpp"
+#include "symbols.hpp"
 #include "types.hpp"
 
 #include <memory>
@@ -24,8 +26,19 @@ namespace pierogi::ast {{
 
 {pointer_type_aliases}
 
+// Nodes don't own each other; an expression is just a handle to a node in
+// the arena of the module it was parsed into
 using expression = std::variant<{all_node_pointer_types}>;
 
+// A parsed source. Its nodes live in `nodes` and are only valid for as long
+// as the module is, and destroying it releases the whole tree at once.
+struct module {{
+    std::unique_ptr<arena::bump_arena> nodes = std::make_unique<arena::bump_arena>();
+    std::vector<expression> expressions;
+    // The table the identifiers' symbols were interned into
+    std::shared_ptr<symbols::symbol_table> symbol_names;
+}};
+
 template <typename T>
 struct visitor {{
     {visitor_methods}
@@ -39,6 +52,130 @@ struct visitor {{
 """
 
 
+FLAT_HEADER_TEMPLATE = """\
+#ifndef PIEROGI_FLAT_AST_HPP
+#define PIEROGI_FLAT_AST_HPP
+
+#include "arena.hpp"
+#include "symbols.hpp"
+#include "types.hpp"
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// The node types of the pointer-based AST double as tags naming the kinds of
+// node here
+namespace pierogi::ast {{
+
+{forward_declarations}
+
+}} // namespace pierogi::ast
+
+namespace pierogi::flat_ast {{
+
+// Where a node sits in its module's node array
+using node_index = uint32_t;
+
+enum class kind : uint8_t {{
+    {kinds}
+}};
+
+// Fields that are nodes or symbols are stored right in the operands. Lists
+// of them are stored out of line in the module's `extra` array, as a count
+// followed by the elements, and the operand is where the count is. Values of
+// any other type go in a pool of their own, and the operand indexes into it.
+struct node {{
+    kind tag;
+    std::array<uint32_t, {operand_count}> operands;
+}};
+
+// A node's fields, read back out of a module, along with the kind of node
+// they belong to
+template <typename T>
+struct view;
+
+{view_definitions}
+
+// A parsed source in a handful of flat arrays, which makes it cheap to copy
+// and trivial to serialize. Nodes only ever refer to nodes added before them.
+class module {{
+public:
+    std::vector<node> nodes;
+    std::vector<uint32_t> extra;
+    std::tuple<{pool_types}> pools;
+    std::vector<node_index> expressions;
+    // The table the identifiers' symbols were interned into
+    std::shared_ptr<symbols::symbol_table> symbol_names;
+
+    // Appends a node of the kind tagged by T, taking its fields in the order
+    // they were declared in
+    template <typename T, typename... TArgs>
+    node_index add(TArgs&&... fields) {{
+        return add_node(static_cast<const T*>(nullptr), std::forward<TArgs>(fields)...);
+    }}
+
+    [[nodiscard]] kind kind_at(node_index index) const {{
+        return nodes[index].tag;
+    }}
+
+    template <typename T>
+    [[nodiscard]] bool is(node_index index) const {{
+        return nodes[index].tag == view<T>::tag;
+    }}
+
+    // The node's kind must be the one tagged by T
+    template <typename T>
+    [[nodiscard]] view<T> get(node_index index) const {{
+        return view_node(static_cast<const T*>(nullptr), nodes[index]);
+    }}
+
+private:
+    node_index push(kind tag, std::array<uint32_t, {operand_count}> operands) {{
+        nodes.push_back({{tag, operands}});
+        return static_cast<node_index>(nodes.size() - 1);
+    }}
+
+    template <typename T>
+    uint32_t push_pooled(const T& value) {{
+        auto& pool = std::get<std::vector<T>>(pools);
+        pool.push_back(value);
+        return static_cast<uint32_t>(pool.size() - 1);
+    }}
+
+    template <typename T>
+    [[nodiscard]] const T& pooled(uint32_t index) const {{
+        return std::get<std::vector<T>>(pools)[index];
+    }}
+
+    uint32_t push_extra(arena::span<const uint32_t> elements) {{
+        auto at = static_cast<uint32_t>(extra.size());
+        extra.push_back(static_cast<uint32_t>(elements.size()));
+        extra.insert(extra.end(), elements.begin(), elements.end());
+        return at;
+    }}
+
+    [[nodiscard]] arena::span<const uint32_t> extra_at(uint32_t at) const {{
+        return {{extra.data() + at + 1, extra[at]}};
+    }}
+
+    {add_node_overloads}
+
+    {view_node_overloads}
+}};
+
+}} // namespace pierogi::flat_ast
+
+#endif // PIEROGI_FLAT_AST_HPP
+"""
+
+INLINE_FIELD_TYPES = {"expression": "node_index", "symbols::symbol_id": "symbols::symbol_id"}
+SPAN_PATTERN = re.compile("arena::span<(.+)>")
+
+
 def extract_name(line: str) -> str:
     name = line.split('|')[0].strip()
     assert re.fullmatch(IDENTIFIER_PATTERN, name)
@@ -81,7 +218,7 @@ def generate_forward_declarations(node_types: List[str]) -> str:
 
 
 def generate_pointer_type_aliases(node_types: List[str], node_pointer_types: List[str]) -> str:
-    alias_template = "using {0} = std::shared_ptr<{1}>;"
+    alias_template = "using {0} = const {1}*;"
     aliases = [alias_template.format(node_pointer_type, node_type)
                for node_pointer_type, node_type in zip(node_pointer_types, node_types)]
     return "\n".join(aliases)
@@ -137,10 +274,106 @@ def generate_class_definitions(node_types: List[str], source_dict: Dict[str, Dic
     return "\n\n".join(definitions)
 
 
+def classify_field(field_type: str) -> str:
+    if field_type in INLINE_FIELD_TYPES:
+        return "inline"
+    match = re.fullmatch(SPAN_PATTERN, field_type)
+    if match:
+        assert match.group(1) in INLINE_FIELD_TYPES
+        return "span"
+    return "pooled"
+
+
+def flat_field_type(field_type: str) -> str:
+    kind = classify_field(field_type)
+    if kind == "inline":
+        return INLINE_FIELD_TYPES[field_type]
+    if kind == "span":
+        element_type = INLINE_FIELD_TYPES[re.fullmatch(SPAN_PATTERN, field_type).group(1)]
+        return "arena::span<const {}>".format(element_type)
+    return "const {}&".format(field_type)
+
+
+def get_pooled_types(source_dict: Dict[str, Dict[str, str]]) -> List[str]:
+    pooled_types = []
+    for field_type_dict in source_dict.values():
+        for field_type in field_type_dict.values():
+            if classify_field(field_type) == "pooled" and field_type not in pooled_types:
+                pooled_types.append(field_type)
+    return pooled_types
+
+
+def generate_view_definitions(node_types: List[str], source_dict: Dict[str, Dict[str, str]]) -> str:
+    definitions = []
+    for node_type in node_types:
+        fields = ["    static constexpr kind tag = kind::{};".format(node_type)]
+        fields += ["    {} {};".format(flat_field_type(field_type), field_name)
+                   for field_name, field_type in source_dict[node_type].items()]
+        definitions.append("template <>\nstruct view<ast::{}> {{\n{}\n}};".format(node_type, "\n".join(fields)))
+    return "\n\n".join(definitions)
+
+
+def generate_add_node_overloads(node_types: List[str], source_dict: Dict[str, Dict[str, str]]) -> str:
+    overloads = []
+    for node_type in node_types:
+        field_type_dict = source_dict[node_type]
+        parameters = ["const ast::{}*".format(node_type)]
+        operands = []
+        for field_name, field_type in field_type_dict.items():
+            parameters.append("{} {}".format(flat_field_type(field_type), field_name))
+            kind = classify_field(field_type)
+            if kind == "inline":
+                operands.append(field_name)
+            elif kind == "span":
+                operands.append("push_extra({})".format(field_name))
+            else:
+                operands.append("push_pooled({})".format(field_name))
+        overloads.append(
+            "node_index add_node({}) {{\n"
+            "        return push(kind::{}, {{{}}});\n"
+            "    }}".format(", ".join(parameters), node_type, ", ".join(operands)))
+    return "\n\n    ".join(overloads)
+
+
+def generate_view_node_overloads(node_types: List[str], source_dict: Dict[str, Dict[str, str]]) -> str:
+    overloads = []
+    for node_type in node_types:
+        fields = []
+        for i, field_type in enumerate(source_dict[node_type].values()):
+            kind = classify_field(field_type)
+            if kind == "inline":
+                fields.append("n.operands[{}]".format(i))
+            elif kind == "span":
+                fields.append("extra_at(n.operands[{}])".format(i))
+            else:
+                fields.append("pooled<{}>(n.operands[{}])".format(field_type, i))
+        node_parameter = "const node& n" if fields else "const node&"
+        overloads.append(
+            "[[nodiscard]] view<ast::{0}> view_node(const ast::{0}*, {1}) const {{\n"
+            "        return {{{2}}};\n"
+            "    }}".format(node_type, node_parameter, ", ".join(fields)))
+    return "\n\n    ".join(overloads)
+
+
+def generate_flat_header(node_types: List[str], source_dict: Dict[str, Dict[str, str]]) -> str:
+    operand_count = max(len(fields) for fields in source_dict.values())
+    pooled_types = get_pooled_types(source_dict)
+    return FLAT_HEADER_TEMPLATE.format(
+        forward_declarations=generate_forward_declarations(node_types),
+        kinds=",\n    ".join(node_types),
+        operand_count=operand_count,
+        view_definitions=generate_view_definitions(node_types, source_dict),
+        pool_types=", ".join("std::vector<{}>".format(t) for t in pooled_types),
+        add_node_overloads=generate_add_node_overloads(node_types, source_dict),
+        view_node_overloads=generate_view_node_overloads(node_types, source_dict))
+
+
 if __name__ == "__main__":
     parser = argparse.ArgumentParser()
     parser.add_argument("input", type=pathlib.Path, help="Path to input .pstl file")
     parser.add_argument("output", type=pathlib.Path, help="Path to output .hpp file")
+    parser.add_argument("--flat", action="store_true",
+                        help="Emit the flat, index-based AST instead of the pointer-based one")
     args = parser.parse_args()
 
     with open(args.input, "r") as input_file:
@@ -150,6 +383,11 @@ if __name__ == "__main__":
     node_types = get_node_types(source_dict)
     node_pointer_types = generate_node_pointer_types(node_types)
 
+    if args.flat:
+        with open(args.output, "w") as output_file:
+            output_file.write(generate_flat_header(node_types, source_dict))
+        raise SystemExit
+
     with open(args.output, "w") as output_file:
         output_file.write(HEADER_TEMPLATE.format(
             forward_declarations=generate_forward_declarations(node_types),
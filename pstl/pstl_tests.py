@@ -43,5 +43,72 @@ class ParserTest(unittest.TestCase):
                          })
 
 
+
+class FlatGeneratorTest(unittest.TestCase):
+
+    SOURCE_DICT = pstl.make_source_dict("""
+        leaf
+        number | types::number value
+        identifier | symbols::symbol_id name
+        negation | expression inside
+        call | expression callee, arena::span<expression> arguments
+        text | std::string contents, types::number width
+        """)
+
+    def generate(self):
+        return pstl.generate_flat_header(pstl.get_node_types(self.SOURCE_DICT), self.SOURCE_DICT)
+
+    def test_field_classification(self):
+        self.assertEqual(pstl.classify_field("expression"), "inline")
+        self.assertEqual(pstl.classify_field("symbols::symbol_id"), "inline")
+        self.assertEqual(pstl.classify_field("arena::span<expression>"), "span")
+        self.assertEqual(pstl.classify_field("arena::span<symbols::symbol_id>"), "span")
+        self.assertEqual(pstl.classify_field("types::number"), "pooled")
+        self.assertEqual(pstl.classify_field("std::string"), "pooled")
+
+    def test_flat_field_types(self):
+        self.assertEqual(pstl.flat_field_type("expression"), "node_index")
+        self.assertEqual(pstl.flat_field_type("symbols::symbol_id"), "symbols::symbol_id")
+        self.assertEqual(pstl.flat_field_type("arena::span<expression>"), "arena::span<const node_index>")
+        self.assertEqual(pstl.flat_field_type("types::number"), "const types::number&")
+
+    def test_pooled_types_are_listed_once_in_order(self):
+        self.assertEqual(pstl.get_pooled_types(self.SOURCE_DICT), ["types::number", "std::string"])
+
+    def test_kinds_and_views(self):
+        header = self.generate()
+        self.assertIn("enum class kind : uint8_t {\n    leaf,\n    number,\n    identifier,", header)
+        self.assertIn("std::array<uint32_t, 2> operands;", header)
+        self.assertIn("template <>\n"
+                      "struct view<ast::leaf> {\n"
+                      "    static constexpr kind tag = kind::leaf;\n"
+                      "};", header)
+        self.assertIn("template <>\n"
+                      "struct view<ast::call> {\n"
+                      "    static constexpr kind tag = kind::call;\n"
+                      "    node_index callee;\n"
+                      "    arena::span<const node_index> arguments;\n"
+                      "};", header)
+
+    def test_module_storage(self):
+        header = self.generate()
+        self.assertIn("std::tuple<std::vector<types::number>, std::vector<std::string>> pools;", header)
+        self.assertIn("node_index add_node(const ast::leaf*) {\n"
+                      "        return push(kind::leaf, {});\n", header)
+        self.assertIn("node_index add_node(const ast::call*, node_index callee, "
+                      "arena::span<const node_index> arguments) {\n"
+                      "        return push(kind::call, {callee, push_extra(arguments)});\n", header)
+        self.assertIn("node_index add_node(const ast::text*, const std::string& contents, "
+                      "const types::number& width) {\n"
+                      "        return push(kind::text, {push_pooled(contents), push_pooled(width)});\n", header)
+        self.assertIn("view_node(const ast::leaf*, const node&) const {\n"
+                      "        return {};\n", header)
+        self.assertIn("view_node(const ast::identifier*, const node& n) const {\n"
+                      "        return {n.operands[0]};\n", header)
+        self.assertIn("view_node(const ast::text*, const node& n) const {\n"
+                      "        return {pooled<std::string>(n.operands[0]), pooled<types::number>(n.operands[1])};\n",
+                      header)
+
+
 if __name__ == "__main__":
     unittest.main()
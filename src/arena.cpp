@@ -0,0 +1,46 @@
+#include "arena.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+
+namespace pierogi::arena {
+
+bump_arena::~bump_arena() {
+    for (auto it = destructors.rbegin(); it != destructors.rend(); ++it) it->destroy(it->object);
+}
+
+void* bump_arena::allocate(size_t size, size_t alignment) {
+    auto address = reinterpret_cast<uintptr_t>(cursor);
+    size_t padding = (alignment - address % alignment) % alignment;
+    if (cursor == nullptr || size + padding > static_cast<size_t>(limit - cursor)) {
+        // Allocations too big for a fresh block get one of their own. Blocks
+        // come from operator new, so they start suitably aligned.
+        size_t capacity = std::max(block_size, size);
+        // Left uninitialized, unlike make_unique would
+        blocks.emplace_back(new std::byte[capacity]);
+        cursor = blocks.back().get();
+        limit = cursor + capacity;
+        padding = 0;
+    }
+    void* memory = cursor + padding;
+    cursor += padding + size;
+    used += size;
+    return memory;
+}
+
+void bump_arena::adopt(bump_arena&& other) {
+    // Keep bumping through our own block; the rest of other's current one
+    // goes unused
+    blocks.insert(blocks.end(), std::make_move_iterator(other.blocks.begin()),
+                  std::make_move_iterator(other.blocks.end()));
+    destructors.insert(destructors.end(), other.destructors.begin(), other.destructors.end());
+    used += other.used;
+    other.blocks.clear();
+    other.destructors.clear();
+    other.cursor = nullptr;
+    other.limit = nullptr;
+    other.used = 0;
+}
+
+} // namespace pierogi::arena
@@ -1,13 +1,55 @@
 #include "errors.hpp"
+#include "source.hpp"
 
+#include <algorithm>
 #include <iostream>
 
 namespace pierogi::errors {
 
-void console_reporter::report(error_type type, const std::string& near_lexeme, int line) {
-    const std::unordered_map<error_type, std::string> error_type_names({
-        {error_type::UNRECOGNIZED_CHARACTER, "Unrecognized token near " + near_lexeme}
-    });
+std::string_view message(error_type type) {
+    switch (type) {
+    case error_type::UNRECOGNIZED_CHARACTER:
+        return "Unrecognized token";
+    case error_type::UNTERMINATED_STRING:
+        return "Unterminated string";
+    case error_type::INVALID_UTF8:
+        return "Invalid UTF-8";
+    case error_type::UNEXPECTED_TOKEN:
+        return "Unexpected token";
+    case error_type::NESTING_TOO_DEEP:
+        return "Nesting too deep";
+    }
+    return "Unknown error";
+}
+
+void console_reporter::report(error_type type, std::string_view near_lexeme, int line, int column) {
+    std::cerr << line << ':' << column << ": " << message(type) << " near '" << near_lexeme << "'\n";
+}
+
+diagnostics::diagnostics(size_t limit) : slots(std::make_unique<diagnostic[]>(limit)), limit(limit) {}
+
+bool diagnostics::record(error_type type, size_t offset, size_t length) {
+    // Each thread claims its own slot, so the writes themselves never race
+    size_t index = count.fetch_add(1, std::memory_order_relaxed);
+    if (index >= limit) return false;
+    slots[index] = {type, static_cast<uint32_t>(offset), static_cast<uint32_t>(length)};
+    return index + 1 < limit;
+}
+
+void diagnostics::flush(std::string_view source, reporter_interface& reporter) {
+    diagnostic* first = slots.get();
+    diagnostic* last = first + size();
+    if (first != last) {
+        std::stable_sort(first, last, [](const diagnostic& a, const diagnostic& b) {
+            return a.offset < b.offset;
+        });
+        source::line_index lines(source);
+        for (const diagnostic* d = first; d != last; d++) {
+            auto where = lines.locate(d->offset);
+            reporter.report(d->type, source.substr(d->offset, d->length), where.line, where.column);
+        }
+    }
+    clear();
 }
 
 } // namespace pierogi::errors
@@ -1,25 +1,563 @@
 #include "lexer.hpp"
+#include "numbers.hpp"
+#include "scanner.hpp"
+#include "unicode.hpp"
 
-#include <sstream>
-#include <unordered_map>
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <iterator>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <thread>
 #include <utility>
+#include <variant>
 
 namespace pierogi::lexer {
 
-token::token(token_type type, std::string lexeme, types::value value, int line)
-    : type(type), lexeme(std::move(lexeme)), value(std::move(value)), line(line) {
+token::token(token_type type, std::string_view lexeme, uint32_t offset, symbols::symbol_id symbol)
+    : type(type), lexeme(lexeme), offset(offset), symbol(symbol) {
 }
 
+namespace {
+
+// Looks up a token's entry in one of token_buffer's sparse side tables
+template <typename TValue>
+TValue find_entry(const std::vector<uint32_t>& indices, const std::vector<TValue>& values, size_t index) {
+    auto it = std::lower_bound(indices.begin(), indices.end(), index);
+    return values[it - indices.begin()];
+}
+
+// Copies the side table entries for tokens [first, last) of another buffer,
+// renumbering them to start at `destination`
+template <typename TValue>
+void append_entries(std::vector<uint32_t>& indices, std::vector<TValue>& values,
+                    const std::vector<uint32_t>& other_indices, const std::vector<TValue>& other_values,
+                    size_t first, size_t last, size_t destination) {
+    auto entry_first = std::lower_bound(other_indices.begin(), other_indices.end(), first);
+    auto entry_last = std::lower_bound(entry_first, other_indices.end(), last);
+    for (auto it = entry_first; it != entry_last; ++it) {
+        indices.push_back(static_cast<uint32_t>(destination + (*it - first)));
+    }
+    values.insert(values.end(),
+                  other_values.begin() + (entry_first - other_indices.begin()),
+                  other_values.begin() + (entry_last - other_indices.begin()));
+}
+
+// Replaces elements [first, last) of `values` with [replacement_first,
+// replacement_last), moving only the elements after the range, and only if
+// the replacement is a different length
+template <typename TValue, typename TIterator>
+void splice(std::vector<TValue>& values, size_t first, size_t last,
+            TIterator replacement_first, TIterator replacement_last) {
+    auto count = static_cast<size_t>(std::distance(replacement_first, replacement_last));
+    size_t overwritten = std::min(count, last - first);
+    std::copy(replacement_first, replacement_first + overwritten, values.begin() + first);
+    if (count > overwritten) {
+        values.insert(values.begin() + last, replacement_first + overwritten, replacement_last);
+    } else {
+        values.erase(values.begin() + first + count, values.begin() + last);
+    }
+}
+
+// Does the same as splice() for the entries of a side table whose tokens are
+// in [first, last), given the side table of the `replacement_size` tokens
+// replacing them. Entries after the range are renumbered.
+template <typename TValue>
+void splice_entries(std::vector<uint32_t>& indices, std::vector<TValue>& values,
+                    size_t first, size_t last, size_t replacement_size,
+                    const std::vector<uint32_t>& replacement_indices, const std::vector<TValue>& replacement_values) {
+    auto entry_first = std::lower_bound(indices.begin(), indices.end(), first) - indices.begin();
+    auto entry_last = std::lower_bound(indices.begin() + entry_first, indices.end(), last) - indices.begin();
+    std::vector<uint32_t> renumbered(replacement_indices);
+    for (uint32_t& index : renumbered) index += static_cast<uint32_t>(first);
+    splice(indices, entry_first, entry_last, renumbered.begin(), renumbered.end());
+    splice(values, entry_first, entry_last, replacement_values.begin(), replacement_values.end());
+    auto shift = static_cast<uint32_t>(replacement_size - (last - first));
+    for (auto it = indices.begin() + entry_first + renumbered.size(); it != indices.end(); ++it) *it += shift;
+}
+
+// Each opening bracket comes right before its closing one in token_type
+static_assert(static_cast<int>(token_type::RIGHT_PARENTHESIS) == static_cast<int>(token_type::LEFT_PARENTHESIS) + 1);
+static_assert(static_cast<int>(token_type::LEFT_SQUARE_BRACKET) == static_cast<int>(token_type::LEFT_PARENTHESIS) + 2);
+static_assert(static_cast<int>(token_type::RIGHT_SQUARE_BRACKET) == static_cast<int>(token_type::LEFT_PARENTHESIS) + 3);
+static_assert(static_cast<int>(token_type::LEFT_BRACE) == static_cast<int>(token_type::LEFT_PARENTHESIS) + 4);
+static_assert(static_cast<int>(token_type::RIGHT_BRACE) == static_cast<int>(token_type::LEFT_PARENTHESIS) + 5);
+
+// Even for opening brackets and odd for closing ones, with a closing bracket
+// one more than the opening bracket it closes. -1 for anything else.
+int bracket_kind(token_type type) {
+    int kind = static_cast<int>(type) - static_cast<int>(token_type::LEFT_PARENTHESIS);
+    if (kind < 0 || kind > static_cast<int>(token_type::RIGHT_BRACE) - static_cast<int>(token_type::LEFT_PARENTHESIS)) {
+        return -1;
+    }
+    return kind;
+}
+
+// The brackets still open right before `edit`, innermost first. They're
+// found by walking back from the edit and jumping over the pairs on the way,
+// and only as far as anything asks for.
+class open_before {
+public:
+    open_before(const token_buffer& tokens, size_t edit) : tokens(tokens), edit(edit), cursor(edit) {}
+
+    // The bracket `depth` below the innermost, or no_partner if there aren't
+    // that many open
+    uint32_t at(size_t depth) {
+        while (found.size() <= depth && cursor > 0) {
+            size_t i = --cursor;
+            int kind = bracket_kind(tokens.type(i));
+            if (kind < 0) continue;
+            uint32_t partner = tokens.partner(i);
+            if (kind % 2 == 1) {
+                if (partner != token_buffer::no_partner) cursor = partner;
+            } else if (partner == token_buffer::no_partner || partner >= edit) {
+                found.push_back(static_cast<uint32_t>(i));
+            }
+        }
+        return depth < found.size() ? found[depth] : token_buffer::no_partner;
+    }
+
+    [[nodiscard]] const std::vector<uint32_t>& found_so_far() const {
+        return found;
+    }
+
+private:
+    const token_buffer& tokens;
+    size_t edit;
+    size_t cursor;
+    std::vector<uint32_t> found;
+};
+
+// The brackets open at some point after an edit: the first `closed_below` of
+// those open before the edit have been closed since, and `opened` have been
+// opened since, innermost last
+struct bracket_stack {
+    struct opening {
+        // no_partner for brackets that the edit removed
+        uint32_t index;
+        token_type type;
+
+        bool operator==(const opening& other) const {
+            return index == other.index;
+        }
+    };
+
+    size_t closed_below = 0;
+    std::vector<opening> opened;
+
+    // Returns the index of the bracket that `type` closes, if it closes one
+    uint32_t feed(token_type type, uint32_t index, open_before& base, const token_buffer& tokens) {
+        int kind = bracket_kind(type);
+        if (kind < 0) return token_buffer::no_partner;
+        if (kind % 2 == 0) {
+            opened.push_back({index, type});
+            return token_buffer::no_partner;
+        }
+        if (!opened.empty()) {
+            if (static_cast<int>(opened.back().type) != static_cast<int>(type) - 1) return token_buffer::no_partner;
+            uint32_t closed = opened.back().index;
+            opened.pop_back();
+            return closed;
+        }
+        uint32_t closed = base.at(closed_below);
+        if (closed == token_buffer::no_partner ||
+            static_cast<int>(tokens.type(closed)) != static_cast<int>(type) - 1) {
+            return token_buffer::no_partner;
+        }
+        closed_below++;
+        return closed;
+    }
+};
+
+} // namespace
+
+symbols::symbol_id token_buffer::symbol(size_t index) const {
+    return find_entry(symbol_indices, symbol_ids, index);
+}
+
+token token_buffer::operator[](size_t index) const {
+    symbols::symbol_id symbol_id = 0;
+    if (types[index] == token_type::IDENTIFIER) symbol_id = symbol(index);
+    return token(types[index], lexeme(index), offsets[index], symbol_id);
+}
+
+void token_buffer::push_back(token_type type, size_t offset, size_t length) {
+    types.push_back(type);
+    offsets.push_back(static_cast<uint32_t>(offset));
+    lengths.push_back(static_cast<uint32_t>(length));
+    partners.push_back(no_partner);
+    match_bracket(types.size() - 1);
+}
+
+void token_buffer::match_bracket(size_t index) {
+    int kind = bracket_kind(types[index]);
+    if (kind < 0) return;
+    if (kind % 2 == 0) {
+        open_brackets.push_back(static_cast<uint32_t>(index));
+        return;
+    }
+    if (open_brackets.empty() || static_cast<int>(types[open_brackets.back()]) != static_cast<int>(types[index]) - 1) {
+        return;
+    }
+    partners[open_brackets.back()] = static_cast<uint32_t>(index);
+    partners[index] = open_brackets.back();
+    open_brackets.pop_back();
+}
+
+void token_buffer::push_identifier(symbols::symbol_id symbol, size_t offset, size_t length) {
+    symbol_indices.push_back(static_cast<uint32_t>(size()));
+    symbol_ids.push_back(symbol);
+    push_back(token_type::IDENTIFIER, offset, length);
+}
+
+void token_buffer::append(const token_buffer& other, size_t first, size_t last) {
+    append_entries(symbol_indices, symbol_ids, other.symbol_indices, other.symbol_ids, first, last, size());
+    types.insert(types.end(), other.types.begin() + first, other.types.begin() + last);
+    offsets.insert(offsets.end(), other.offsets.begin() + first, other.offsets.begin() + last);
+    lengths.insert(lengths.end(), other.lengths.begin() + first, other.lengths.begin() + last);
+    // The other buffer's pairs only cover its own tokens
+    size_t appended_start = partners.size();
+    partners.resize(size(), no_partner);
+    for (size_t i = appended_start; i < size(); i++) match_bracket(i);
+}
+
+void token_buffer::replace(size_t first, size_t last, const token_buffer& replacement, std::ptrdiff_t offset_shift) {
+    // Pair brackets again from the edit on, alongside how they were paired
+    // before it, until both have the same brackets open. Everything after
+    // that pairs up as it did before. Brackets the edit removed are stacked
+    // as no_partner, so they never line up with anything.
+    open_before base(*this, first);
+    bracket_stack before_edit;
+    bracket_stack after_edit;
+    for (size_t i = first; i < last; i++) before_edit.feed(types[i], no_partner, base, *this);
+    const auto removed = static_cast<std::ptrdiff_t>(last - first);
+    const auto inserted = static_cast<std::ptrdiff_t>(replacement.size());
+    std::vector<uint32_t> open_at_end = std::move(open_brackets);
+    open_brackets.clear();
+
+    splice_entries(symbol_indices, symbol_ids, first, last, replacement.size(),
+                   replacement.symbol_indices, replacement.symbol_ids);
+    splice(types, first, last, replacement.types.begin(), replacement.types.end());
+    splice(offsets, first, last, replacement.offsets.begin(), replacement.offsets.end());
+    splice(lengths, first, last, replacement.lengths.begin(), replacement.lengths.end());
+    for (size_t i = first + replacement.size(); i < offsets.size(); i++) {
+        offsets[i] = static_cast<uint32_t>(offsets[i] + offset_shift);
+    }
+    source_text = replacement.source_text;
+
+    std::vector<uint32_t> no_partners(replacement.size(), no_partner);
+    splice(partners, first, last, no_partners.begin(), no_partners.end());
+    const size_t tail = first + replacement.size();
+    if (inserted != removed) {
+        for (size_t i = tail; i < size(); i++) {
+            if (partners[i] == no_partner) continue;
+            if (partners[i] >= last) {
+                partners[i] = static_cast<uint32_t>(partners[i] + inserted - removed);
+            } else if (partners[i] < first) {
+                partners[partners[i]] = static_cast<uint32_t>(i);
+            }
+        }
+    }
+    auto pair_up = [&](size_t i) {
+        uint32_t opening = after_edit.feed(types[i], static_cast<uint32_t>(i), base, *this);
+        // Opening brackets keep their partners until something closes them
+        if (bracket_kind(types[i]) % 2 != 1) return;
+        partners[i] = opening;
+        if (opening != no_partner) partners[opening] = static_cast<uint32_t>(i);
+    };
+    for (size_t i = first; i < tail; i++) pair_up(i);
+
+    // How many brackets at the bottom of `opened` are the same before and
+    // after the edit
+    size_t same = 0;
+    while (same < before_edit.opened.size() && same < after_edit.opened.size() &&
+           before_edit.opened[same] == after_edit.opened[same]) {
+        same++;
+    }
+    auto lined_up = [&] {
+        return before_edit.closed_below == after_edit.closed_below &&
+               same == before_edit.opened.size() && same == after_edit.opened.size();
+    };
+    size_t i = tail;
+    for (; i < size() && !lined_up(); i++) {
+        bool was_lined_up = same == before_edit.opened.size() && same == after_edit.opened.size();
+        before_edit.feed(types[i], static_cast<uint32_t>(i), base, *this);
+        pair_up(i);
+        if (was_lined_up && bracket_kind(types[i]) % 2 == 0) same++;
+        same = std::min({same, before_edit.opened.size(), after_edit.opened.size()});
+    }
+    if (lined_up()) {
+        for (uint32_t& index : open_at_end) {
+            if (index >= last) index = static_cast<uint32_t>(index + inserted - removed);
+        }
+        open_brackets = std::move(open_at_end);
+        return;
+    }
+
+    // Whatever's still open at the end stays unpaired. Below the brackets
+    // found before the edit are those that nothing reached, which are at the
+    // bottom of what was open at the end before.
+    const std::vector<uint32_t>& found = base.found_so_far();
+    uint32_t reached = found.empty() ? static_cast<uint32_t>(first) : found.back();
+    for (uint32_t index : open_at_end) {
+        if (index < reached) open_brackets.push_back(index);
+    }
+    for (size_t depth = found.size(); depth-- > after_edit.closed_below;) {
+        partners[found[depth]] = no_partner;
+        open_brackets.push_back(found[depth]);
+    }
+    for (const auto& opening : after_edit.opened) {
+        partners[opening.index] = no_partner;
+        open_brackets.push_back(opening.index);
+    }
+}
+
+void token_buffer::reserve(size_t token_count) {
+    types.reserve(token_count);
+    offsets.reserve(token_count);
+    lengths.reserve(token_count);
+    partners.reserve(token_count);
+}
+
+void token_buffer::clear() {
+    types.clear();
+    offsets.clear();
+    lengths.clear();
+    symbol_indices.clear();
+    symbol_ids.clear();
+    partners.clear();
+    open_brackets.clear();
+}
+
+namespace {
+
+struct keyword {
+    std::string_view spelling;
+    token_type type;
+};
+
+constexpr keyword keywords[] = {
+    {"and", token_type::AND},
+    {"or", token_type::OR},
+    {"not", token_type::NOT},
+    {"true", token_type::TRUE},
+    {"false", token_type::FALSE},
+    {"nil", token_type::NIL}
+};
+
+constexpr size_t keyword_table_size = 16;
+
+// A perfect hash over `keywords`: no two keywords share a slot, so any word can
+// be classified with one hash and one comparison. If a new keyword collides,
+// adjust the multiplier until the static_assert below passes.
+constexpr size_t keyword_slot(std::string_view word) {
+    return (word.size() + word.front() + 5 * word.back()) % keyword_table_size;
+}
+
+constexpr std::array<keyword, keyword_table_size> make_keyword_table() {
+    std::array<keyword, keyword_table_size> table{};
+    for (auto& slot : table) slot = {"", token_type::IDENTIFIER};
+    for (const keyword& k : keywords) table[keyword_slot(k.spelling)] = k;
+    return table;
+}
+
+constexpr std::array<keyword, keyword_table_size> keyword_table = make_keyword_table();
+
+constexpr bool keyword_table_is_perfect() {
+    for (const keyword& k : keywords) {
+        if (keyword_table[keyword_slot(k.spelling)].type != k.type) return false;
+    }
+    return true;
+}
+
+static_assert(keyword_table_is_perfect(), "keyword_slot() must not map two keywords to the same slot");
+
+// Words are never empty, since they always start with an alphabetic character
+constexpr token_type classify_word(std::string_view word) {
+    const keyword& candidate = keyword_table[keyword_slot(word)];
+    return candidate.spelling == word ? candidate.type : token_type::IDENTIFIER;
+}
+
+struct operator_spelling {
+    std::string_view spelling;
+    token_type type;
+};
+
+// Every operator the lexer recognizes. The table-driven lexer's automaton is
+// generated from this list, so a new operator only needs a line here (and a
+// case in the switch lexer, which is kept around to check the tables against).
+constexpr operator_spelling operators[] = {
+    {"(", token_type::LEFT_PARENTHESIS},
+    {")", token_type::RIGHT_PARENTHESIS},
+    {"[", token_type::LEFT_SQUARE_BRACKET},
+    {"]", token_type::RIGHT_SQUARE_BRACKET},
+    {"{", token_type::LEFT_BRACE},
+    {"}", token_type::RIGHT_BRACE},
+    {":", token_type::COLON},
+    {",", token_type::COMMA},
+    {".", token_type::DOT},
+    {"-", token_type::MINUS},
+    {"+", token_type::PLUS},
+    {"^", token_type::CARET},
+    {"/", token_type::SLASH},
+    {"\\", token_type::BACKSLASH},
+    {"*", token_type::ASTERISK},
+    {"=", token_type::EQUAL},
+    {"==", token_type::EQUAL_EQUAL},
+    {"/=", token_type::NOT_EQUAL},
+    {">", token_type::GREATER_THAN},
+    {">=", token_type::GREATER_EQUAL},
+    {"<", token_type::LESS_THAN},
+    {"<=", token_type::LESS_EQUAL},
+    {"..", token_type::DOT_DOT}
+};
+
+enum class char_class : uint8_t {
+    INVALID,
+    OPERATOR,
+    WHITESPACE,
+    COMMENT,
+    QUOTE,
+    DIGIT,
+    ALPHABETIC,
+    NON_ASCII
+};
+
+constexpr std::array<char_class, 256> make_char_classes() {
+    std::array<char_class, 256> classes{};
+    for (const operator_spelling& op : operators) {
+        classes[static_cast<unsigned char>(op.spelling.front())] = char_class::OPERATOR;
+    }
+    classes[' '] = classes['\t'] = classes['\r'] = classes['\n'] = char_class::WHITESPACE;
+    classes['#'] = char_class::COMMENT;
+    classes['"'] = char_class::QUOTE;
+    for (unsigned char c = '0'; c <= '9'; c++) classes[c] = char_class::DIGIT;
+    for (unsigned char c = 'a'; c <= 'z'; c++) classes[c] = char_class::ALPHABETIC;
+    for (unsigned char c = 'A'; c <= 'Z'; c++) classes[c] = char_class::ALPHABETIC;
+    classes['_'] = char_class::ALPHABETIC;
+    for (size_t c = 0x80; c <= 0xFF; c++) classes[c] = char_class::NON_ASCII;
+    return classes;
+}
+
+constexpr std::array<char_class, 256> char_classes = make_char_classes();
+
+constexpr size_t operator_state_limit() {
+    size_t limit = 1;
+    for (const operator_spelling& op : operators) limit += op.spelling.size();
+    return limit;
+}
+
+// A trie of the operator spellings laid out as a DFA. State 0 is the start
+// state and doubles as "no transition", since nothing ever leads back to it.
+struct operator_automaton {
+    std::array<std::array<uint8_t, 256>, operator_state_limit()> transitions{};
+    std::array<token_type, operator_state_limit()> accepts{};
+    std::array<bool, operator_state_limit()> accepting{};
+};
+
+constexpr operator_automaton make_operator_automaton() {
+    operator_automaton automaton{};
+    uint8_t state_count = 1;
+    for (const operator_spelling& op : operators) {
+        uint8_t state = 0;
+        for (char c : op.spelling) {
+            uint8_t& next = automaton.transitions[state][static_cast<unsigned char>(c)];
+            if (next == 0) next = state_count++;
+            state = next;
+        }
+        automaton.accepts[state] = op.type;
+        automaton.accepting[state] = true;
+    }
+    return automaton;
+}
+
+constexpr operator_automaton operator_dfa = make_operator_automaton();
+
+// The lexer stops at the first byte with no transition and emits whatever
+// the current state accepts, so it never has to back up. That only works if
+// every state reachable from the start is accepting.
+constexpr bool operator_prefixes_are_operators() {
+    for (size_t state = 0; state < operator_state_limit(); state++) {
+        for (uint8_t next : operator_dfa.transitions[state]) {
+            if (next != 0 && !operator_dfa.accepting[next]) return false;
+        }
+    }
+    return true;
+}
+
+static_assert(operator_prefixes_are_operators(), "Every prefix of an operator must be an operator itself");
+
+// Lines and columns are only needed for error messages, so the source's line
+// index isn't built until the first error. Lexers working on the same source
+// in parallel share one.
+class lazy_line_index {
+public:
+    explicit lazy_line_index(std::string_view text) : text(text) {}
+
+    source::location locate(size_t offset) {
+        std::call_once(built, [this] { index.emplace(text); });
+        return index->locate(offset);
+    }
+
+private:
+    std::string_view text;
+    std::once_flag built;
+    std::optional<source::line_index> index;
+};
+
+// Where a lexer's errors go: straight to a reporter, into a diagnostics
+// buffer, or held back in a list while a chunk is lexed speculatively
+class error_sink {
+public:
+    error_sink(errors::reporter_interface& reporter) : destination(&reporter) {}
+    error_sink(errors::diagnostics& log) : destination(&log) {}
+    error_sink(std::vector<errors::diagnostic>& held) : destination(&held) {}
+
+    // Returns false once the lexer should stop
+    bool report(errors::error_type type, size_t offset, size_t length,
+                std::string_view source, lazy_line_index& lines) const {
+        if (auto log = std::get_if<errors::diagnostics*>(&destination)) return (*log)->record(type, offset, length);
+        if (auto held = std::get_if<std::vector<errors::diagnostic>*>(&destination)) {
+            (*held)->push_back({type, static_cast<uint32_t>(offset), static_cast<uint32_t>(length)});
+            return true;
+        }
+        auto where = lines.locate(offset);
+        std::get<errors::reporter_interface*>(destination)->report(type, source.substr(offset, length), where.line,
+                                                                   where.column);
+        return true;
+    }
+
+private:
+    std::variant<errors::reporter_interface*, errors::diagnostics*, std::vector<errors::diagnostic>*> destination;
+};
+
+} // namespace
+
 struct state {
-    std::string source;
-    errors::reporter_interface& error_reporter;
-    std::vector<token> tokens;
-    int line = 1;
+    std::string_view source;
+    error_sink error_output;
+    const scanner::scanners& scan = scanner::best_scanners();
+    std::shared_ptr<lazy_line_index> lines;
+    token_buffer tokens;
     size_t lexeme_start_index = 0, current_char_index = 0;
+    // Set once check_encoding() has found the whole source to be ASCII, which
+    // lets identifiers skip looking for multi-byte letters
+    bool ascii_only = false;
+    // Set once the diagnostics buffer has filled up, after which the lexer
+    // acts as though it has reached the end of the source
+    bool stopped = false;
 
-    state(std::string source,
-          errors::reporter_interface& error_reporter)
-        : source(std::move(source)), error_reporter(error_reporter) {
+    state(std::string_view source,
+          error_sink error_output,
+          std::shared_ptr<symbols::symbol_table> symbol_names = nullptr,
+          std::shared_ptr<lazy_line_index> lines = nullptr)
+        : source(source), error_output(error_output),
+          lines(lines ? std::move(lines) : std::make_shared<lazy_line_index>(source)),
+          tokens(source, symbol_names ? std::move(symbol_names) : std::make_shared<symbols::symbol_table>()) {
+        if (source.size() > UINT32_MAX) throw std::length_error("Sources must be smaller than 4 GiB");
     }
     
     [[nodiscard]] bool at_end() const {
@@ -41,13 +579,126 @@ struct state {
         return source[current_char_index + 1];
     }
 
-    [[nodiscard]] std::string get_current_lexeme() const {
+    // Moves the current position to the pointer returned by one of the scanners
+    void skip_to(const char* position) {
+        current_char_index = position - source.data();
+    }
+
+    [[nodiscard]] const char* current_position() const {
+        return source.data() + current_char_index;
+    }
+
+    [[nodiscard]] const char* end_position() const {
+        return source.data() + source.size();
+    }
+
+    [[nodiscard]] std::string_view get_current_lexeme() const {
         return source.substr(lexeme_start_index, current_char_index - lexeme_start_index);
     }
 
-    void lex_source() {
-        while (!at_end()) lex_next_token();
-        tokens.emplace_back(token_type::EOF_, "", std::nullopt, line);
+    void lex_source(dispatch strategy) {
+        ascii_only = check_encoding(0, source.size());
+        lex_until(source.size(), strategy);
+        add_eof_token();
+    }
+
+    // Lexes every token that starts before `limit`; the last of them may run
+    // past it. Stops at the first position at or after `limit` where a new
+    // token could begin.
+    void lex_until(size_t limit, dispatch strategy) {
+        if (strategy == dispatch::TABLE) {
+            while (current_char_index < limit && !at_end()) lex_next_token_from_tables();
+        } else {
+            while (current_char_index < limit && !at_end()) lex_next_token();
+        }
+    }
+
+    void lex_next(dispatch strategy) {
+        if (strategy == dispatch::TABLE) {
+            lex_next_token_from_tables();
+        } else {
+            lex_next_token();
+        }
+    }
+
+    // Lexes until exactly one token has been added to `tokens`, which is the
+    // EOF token once the source runs out
+    void lex_one_token(dispatch strategy) {
+        while (tokens.empty() && !at_end()) lex_next(strategy);
+        if (tokens.empty()) add_eof_token();
+    }
+
+    void add_eof_token() {
+        tokens.push_back(token_type::EOF_, source.size(), 0);
+    }
+
+    void report_error(errors::error_type type) {
+        report_error(type, lexeme_start_index, current_char_index);
+    }
+
+    void report_error(errors::error_type type, size_t start, size_t end) {
+        if (!error_output.report(type, start, end - start, source, *lines)) stop();
+    }
+
+    void stop() {
+        stopped = true;
+        current_char_index = source.size();
+    }
+
+    // Reports each stretch of [from, to) that isn't valid UTF-8, where `from`
+    // and `to` are at the starts of characters, and returns whether the range
+    // is pure ASCII
+    bool check_encoding(size_t from, size_t to) {
+        const char* end = source.data() + to;
+        const char* position = scan.find_non_ascii(source.data() + from, end);
+        if (position == end) return true;
+        while ((position = scan.validate_utf8(position, end)) != end) {
+            const char* invalid = position++;
+            // Stray continuation bytes belong to the same error
+            while (position != end && (static_cast<unsigned char>(*position) & 0xC0) == 0x80) position++;
+            report_error(errors::error_type::INVALID_UTF8, invalid - source.data(), position - source.data());
+            if (stopped) break;
+        }
+        return false;
+    }
+
+    void lex_next_token_from_tables() {
+        lexeme_start_index = current_char_index;
+        auto c = static_cast<unsigned char>(source[current_char_index++]);
+        switch (char_classes[c]) {
+        case char_class::OPERATOR: {
+            uint8_t state = operator_dfa.transitions[0][c];
+            while (!at_end()) {
+                uint8_t next = operator_dfa.transitions[state][static_cast<unsigned char>(source[current_char_index])];
+                if (next == 0) break;
+                state = next;
+                current_char_index++;
+            }
+            add_token(operator_dfa.accepts[state]);
+            break;
+        }
+        case char_class::WHITESPACE:
+            skip_to(scan.skip_whitespace(current_position(), end_position()));
+            break;
+        case char_class::COMMENT:
+            skip_to(scan.find_line_end(current_position(), end_position()));
+            break;
+        case char_class::QUOTE:
+            consume_string();
+            break;
+        case char_class::DIGIT:
+            consume_number();
+            break;
+        case char_class::ALPHABETIC:
+            consume_word();
+            break;
+        case char_class::NON_ASCII:
+            consume_non_ascii();
+            break;
+        case char_class::INVALID:
+            report_error(errors::error_type::UNRECOGNIZED_CHARACTER);
+            break;
+        }
     }
 
     void lex_next_token() {
@@ -111,13 +762,11 @@ struct state {
         case ' ':
         case '\t':
         case '\r':
-            break;
         case '\n':
-            line++;
+            skip_to(scan.skip_whitespace(current_position(), end_position()));
             break;
         case '#':
-            while (peek_current() != '\n' && !at_end())
-                consume_current();
+            skip_to(scan.find_line_end(current_position(), end_position()));
             break;
         case '"':
             // TODO: Recognize single-quoted strings too
@@ -128,19 +777,17 @@ struct state {
                 consume_number();
             } else if (is_alphabetic(c)) {
                 consume_word();
+            } else if (static_cast<unsigned char>(c) >= 0x80) {
+                consume_non_ascii();
             } else {
-                error_reporter.report(errors::error_type::UNRECOGNIZED_CHARACTER, get_current_lexeme(), line);
+                report_error(errors::error_type::UNRECOGNIZED_CHARACTER);
             }
         }
 
     }
 
     void add_token(token_type type) {
-        add_token(type, "", std::nullopt); // TODO: add a layer of indirection over our internal NIL representation
-    }
-
-    void add_token(token_type type, const std::string& lexeme, const types::value& value) {
-        tokens.emplace_back(type, lexeme, value, line);
+        tokens.push_back(type, lexeme_start_index, current_char_index - lexeme_start_index);
     }
 
     bool consume_current_if_matches(char expected) {
@@ -150,18 +797,17 @@ struct state {
     }
 
     void consume_string() {
-        while (peek_current() != '"') {
-            if (at_end()) {
-                error_reporter.report(errors::error_type::UNTERMINATED_STRING, get_current_lexeme(), line);
-                return;
-            }
-            else if (peek_current() == '\n') line++;
-            consume_current();
+        skip_to(scan.find_string_end(current_position(), end_position()));
+        if (at_end()) {
+            // The string runs to the end of the source, so only the line it
+            // starts on is reported rather than possibly the whole file
+            size_t line_end = std::min(source.find('\n', lexeme_start_index), source.size());
+            report_error(errors::error_type::UNTERMINATED_STRING, lexeme_start_index, line_end);
+            return;
         }
         consume_current(); // Consume closing '"'
-        std::string lexeme = get_current_lexeme();
-        std::string contents = lexeme.substr(1, lexeme.size() - 2);
-        add_token(token_type::STRING, lexeme, contents);
+        // The contents are left in the source until the parser asks for them
+        add_token(token_type::STRING);
     }
 
     void consume_number() {
@@ -172,23 +818,44 @@ struct state {
             while (is_digit(peek_current()))
                 consume_current();
         }
-        const std::string lexeme = get_current_lexeme();
-        types::number value = std::stold(lexeme);
-        add_token(token_type::NUMBER, lexeme, value);
+        // The value is left in the source until the parser asks for it
+        add_token(token_type::NUMBER);
+    }
+
+    // The first byte of a multi-byte character has been consumed
+    void consume_non_ascii() {
+        auto decoded = unicode::decode(source.data() + lexeme_start_index, end_position());
+        // Invalid sequences were already reported by check_encoding()
+        if (decoded.length == 0) return;
+        current_char_index = lexeme_start_index + decoded.length;
+        if (unicode::is_letter(decoded.code_point)) {
+            consume_word();
+        } else {
+            report_error(errors::error_type::UNRECOGNIZED_CHARACTER);
+        }
+    }
+
+    // Consumes the letter at the current position if it's a multi-byte one
+    bool consume_non_ascii_letter() {
+        if (at_end() || static_cast<unsigned char>(peek_current()) < 0x80) return false;
+        auto decoded = unicode::decode(current_position(), end_position());
+        if (decoded.length == 0 || !unicode::is_letter(decoded.code_point)) return false;
+        current_char_index += decoded.length;
+        return true;
     }
 
     void consume_word() {
-        static const std::unordered_map<std::string, token_type> keywords = {
-            {"and", token_type::AND},
-            {"or", token_type::OR},
-            {"not", token_type::NOT},
-            {"true", token_type::TRUE},
-            {"false", token_type::FALSE},
-            {"nil", token_type::NIL}
-        };
-        while (is_alphanumeric(peek_current())) consume_current();
-        auto it = keywords.find(get_current_lexeme());
-        add_token(it != keywords.end() ? it->second : token_type::IDENTIFIER);
+        skip_to(scan.skip_identifier(current_position(), end_position()));
+        if (!ascii_only) {
+            while (consume_non_ascii_letter()) skip_to(scan.skip_identifier(current_position(), end_position()));
+        }
+        std::string_view word = get_current_lexeme();
+        token_type type = classify_word(word);
+        if (type == token_type::IDENTIFIER) {
+            tokens.push_identifier(tokens.symbols()->intern(word), lexeme_start_index, word.size());
+        } else {
+            add_token(type);
+        }
     }
 
     static bool is_digit(char c) {
@@ -200,17 +867,294 @@ struct state {
                ('A' <= c && c <= 'Z') ||
                c == '_';
     }
+};
 
-    static bool is_alphanumeric(char c) {
-        return is_alphabetic(c) || is_digit(c);
-    }
+namespace {
+
+token_buffer lex(std::string_view source, error_sink error_output, dispatch strategy) {
+    state lexer(source, error_output);
+    lexer.lex_source(strategy);
+    return std::move(lexer.tokens);
+}
+
+} // namespace
+
+token_buffer tokenize(std::string_view source,
+                      errors::reporter_interface& error_reporter,
+                      dispatch strategy) {
+    return lex(source, error_reporter, strategy);
+}
+
+token_buffer tokenize(std::string_view source,
+                      errors::diagnostics& diagnostics,
+                      dispatch strategy) {
+    return lex(source, diagnostics, strategy);
+}
+
+namespace {
+
+// A slice of the source lexed speculatively, as though no string began
+// before it. Its errors are held back until we know which of them the
+// serial lexer would have reported too.
+struct chunk {
+    size_t start = 0, limit = 0, end = 0;
+    token_buffer tokens;
+    std::vector<errors::diagnostic> errors;
 };
 
-std::vector<token> tokenize(const std::string& source,
-                            errors::reporter_interface& error_reporter) {
-    state lexer(source, error_reporter);
-    lexer.lex_source();
-    return lexer.tokens;
+void lex_chunk(std::string_view source, chunk& c,
+               std::shared_ptr<symbols::symbol_table> symbol_names,
+               std::shared_ptr<lazy_line_index> lines,
+               bool ascii_only,
+               dispatch strategy) {
+    state lexer(source, c.errors, std::move(symbol_names), std::move(lines));
+    lexer.ascii_only = ascii_only;
+    lexer.current_char_index = c.start;
+    lexer.lex_until(c.limit, strategy);
+    c.tokens = std::move(lexer.tokens);
+    c.end = lexer.current_char_index;
+}
+
+// Chunks start right after a newline, so they can never start inside a
+// comment. They can still start inside a multi-line string.
+std::vector<chunk> split_into_chunks(std::string_view source, const parallel_options& options) {
+    size_t thread_count = options.thread_count != 0 ? options.thread_count : std::thread::hardware_concurrency();
+    size_t chunk_count = std::max<size_t>(1, std::min(thread_count, source.size() / std::max<size_t>(1, options.min_chunk_size)));
+    std::vector<chunk> chunks;
+    size_t start = 0;
+    for (size_t i = 1; i <= chunk_count && start < source.size(); i++) {
+        size_t limit = source.size();
+        if (i < chunk_count) {
+            size_t newline = source.find('\n', std::max(start, i * source.size() / chunk_count));
+            if (newline != std::string_view::npos) limit = newline + 1;
+        }
+        chunks.emplace_back();
+        chunks.back().start = start;
+        chunks.back().limit = limit;
+        start = limit;
+    }
+    return chunks;
+}
+
+token_buffer lex_parallel(std::string_view source, error_sink error_output, const parallel_options& options) {
+    std::vector<chunk> chunks = split_into_chunks(source, options);
+    if (chunks.size() <= 1) return lex(source, error_output, options.strategy);
+
+    auto symbol_names = std::make_shared<symbols::symbol_table>();
+    auto lines = std::make_shared<lazy_line_index>(source);
+    token_buffer tokens(source, symbol_names);
+    // Encoding errors come first, just as they do from tokenize(). The check
+    // is vectorized and much faster than lexing, so it isn't worth splitting.
+    state encoding(source, error_output, symbol_names, lines);
+    bool ascii_only = encoding.check_encoding(0, source.size());
+    if (encoding.stopped) {
+        tokens.push_back(token_type::EOF_, source.size(), 0);
+        return tokens;
+    }
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < chunks.size(); i++) {
+        workers.emplace_back(lex_chunk, source, std::ref(chunks[i]), symbol_names, lines, ascii_only, options.strategy);
+    }
+    lex_chunk(source, chunks.front(), symbol_names, lines, ascii_only, options.strategy);
+    for (std::thread& worker : workers) worker.join();
+
+    size_t token_count = 1;
+    for (const chunk& c : chunks) token_count += c.tokens.size();
+    tokens.reserve(token_count);
+    // Where the serial lexer would be about to start its next token
+    size_t resume_index = 0;
+    for (chunk& c : chunks) {
+        // The previous chunk's last token swallowed this whole chunk
+        if (resume_index >= c.limit) continue;
+
+        size_t first_kept = 0;
+        if (resume_index > c.start) {
+            // The previous chunk's last token ran into this one, so this
+            // chunk's speculative tokens may be misaligned. Lex from the
+            // true boundary until it lines up with one of them again.
+            auto starts_at = [&](size_t offset) {
+                while (first_kept < c.tokens.size() && c.tokens.offset(first_kept) < offset) first_kept++;
+                return first_kept < c.tokens.size() && c.tokens.offset(first_kept) == offset;
+            };
+            state relexer(source, error_output, symbol_names, lines);
+            relexer.ascii_only = ascii_only;
+            relexer.current_char_index = resume_index;
+            while (relexer.current_char_index < c.limit && !relexer.at_end() &&
+                   !starts_at(relexer.current_char_index)) {
+                relexer.lex_next(options.strategy);
+            }
+            tokens.append(relexer.tokens, 0, relexer.tokens.size());
+            resume_index = relexer.current_char_index;
+            if (resume_index >= c.limit || relexer.at_end()) continue;
+        }
+
+        // If the errors fill the diagnostics buffer, the serial lexer would
+        // have stopped right after the one that filled it
+        size_t last_kept = c.tokens.size();
+        bool stopped = false;
+        for (const errors::diagnostic& error : c.errors) {
+            if (error.offset < resume_index) continue;
+            if (!error_output.report(error.type, error.offset, error.length, source, *lines)) {
+                while (last_kept > first_kept && c.tokens.offset(last_kept - 1) >= error.offset) last_kept--;
+                stopped = true;
+                break;
+            }
+        }
+        tokens.append(c.tokens, first_kept, std::max(first_kept, last_kept));
+        if (stopped) break;
+        resume_index = c.end;
+    }
+    tokens.push_back(token_type::EOF_, source.size(), 0);
+    return tokens;
+}
+
+} // namespace
+
+token_buffer tokenize_parallel(std::string_view source,
+                               errors::reporter_interface& error_reporter,
+                               const parallel_options& options) {
+    return lex_parallel(source, error_reporter, options);
+}
+
+token_buffer tokenize_parallel(std::string_view source,
+                               errors::diagnostics& diagnostics,
+                               const parallel_options& options) {
+    return lex_parallel(source, diagnostics, options);
+}
+
+file_tokens tokenize_file(const std::filesystem::path& path,
+                          errors::reporter_interface& error_reporter,
+                          dispatch strategy) {
+    auto source = std::make_shared<const source::mapped_file>(path);
+    auto tokens = tokenize(source->contents(), error_reporter, strategy);
+    return {std::move(source), std::move(tokens)};
+}
+
+namespace {
+
+void relex_with(token_buffer& tokens,
+                std::string_view new_source,
+                const edit& change,
+                error_sink error_output,
+                dispatch strategy) {
+    // Whether a token ends where it does can depend on the two bytes after
+    // it ("12." only continues a number if a digit follows the '.'), so the
+    // first token the edit can change is the first one that ends fewer than
+    // two bytes before it
+    size_t first = 0, high = tokens.size();
+    while (first < high) {
+        size_t middle = first + (high - first) / 2;
+        if (tokens.offset(middle) + tokens.length(middle) + 2 <= change.offset) {
+            first = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    size_t restart_index = first == 0 ? 0 : tokens.offset(first - 1) + tokens.length(first - 1);
+
+    // Tokens that start after the removed bytes are unaffected apart from
+    // their offsets, so lexing can stop once it reaches where one starts now
+    auto shift = static_cast<std::ptrdiff_t>(change.inserted_length) - static_cast<std::ptrdiff_t>(change.removed_length);
+    size_t last = first;
+    auto starts_at = [&](size_t position) {
+        auto shifted_offset = [&](size_t index) {
+            return static_cast<size_t>(static_cast<std::ptrdiff_t>(tokens.offset(index)) + shift);
+        };
+        while (tokens.offset(last) < change.offset + change.removed_length || shifted_offset(last) < position) last++;
+        return shifted_offset(last) == position;
+    };
+    // The EOF token always starts after the edit, so this stops at the end
+    // of the source at the latest
+    state relexer(new_source, error_output, tokens.symbols());
+    relexer.current_char_index = restart_index;
+    // Only the inserted bytes can have broken the encoding, but the check has
+    // to cover whole characters
+    size_t check_end = std::min(new_source.size(), change.offset + change.inserted_length);
+    while (check_end < new_source.size() && (static_cast<unsigned char>(new_source[check_end]) & 0xC0) == 0x80) {
+        check_end++;
+    }
+    relexer.check_encoding(restart_index, check_end);
+    while (!starts_at(relexer.current_char_index)) relexer.lex_next(strategy);
+    tokens.replace(first, last, relexer.tokens, shift);
+}
+
+} // namespace
+
+void relex(token_buffer& tokens,
+           std::string_view new_source,
+           const edit& change,
+           errors::reporter_interface& error_reporter,
+           dispatch strategy) {
+    relex_with(tokens, new_source, change, error_reporter, strategy);
+}
+
+void relex(token_buffer& tokens,
+           std::string_view new_source,
+           const edit& change,
+           errors::diagnostics& diagnostics,
+           dispatch strategy) {
+    relex_with(tokens, new_source, change, diagnostics, strategy);
+}
+
+token_stream::token_stream(std::string_view source,
+                           errors::reporter_interface& error_reporter,
+                           dispatch strategy)
+    : token_stream(std::make_unique<state>(source, error_reporter), strategy) {}
+
+token_stream::token_stream(std::string_view source,
+                           errors::diagnostics& diagnostics,
+                           dispatch strategy)
+    : token_stream(std::make_unique<state>(source, diagnostics), strategy) {}
+
+token_stream::token_stream(std::unique_ptr<state> lexer, dispatch strategy)
+    : lexer(std::move(lexer)), strategy(strategy),
+      ring(ring_size, token(token_type::EOF_, this->lexer->source.substr(this->lexer->source.size()),
+                            static_cast<uint32_t>(this->lexer->source.size()))) {
+    this->lexer->ascii_only = this->lexer->check_encoding(0, this->lexer->source.size());
+}
+
+token_stream::~token_stream() = default;
+
+const token& token_stream::peek(size_t distance) {
+    assert(distance < max_lookahead);
+    while (lexed_count <= current_index + distance) {
+        lexer->lex_one_token(strategy);
+        ring[lexed_count % ring_size] = lexer->tokens.front();
+        // The EOF token is left with the lexer so it's handed out again on
+        // every later call, which makes peeking past the end harmless
+        if (lexer->tokens.type(0) != token_type::EOF_) lexer->tokens.clear();
+        lexed_count++;
+    }
+    return ring[(current_index + distance) % ring_size];
+}
+
+const std::shared_ptr<symbols::symbol_table>& token_stream::symbols() const {
+    return lexer->tokens.symbols();
+}
+
+std::string_view token_stream::source() const {
+    return lexer->source;
+}
+
+const token& token_stream::previous() const {
+    return ring[(current_index - 1) % ring_size];
+}
+
+void token_stream::advance() {
+    peek();
+    current_index++;
+}
+
+std::string_view string_contents(const token& string_token) {
+    return string_token.lexeme.substr(1, string_token.lexeme.size() - 2);
+}
+
+types::number decode_number(const token& number_token) {
+    return numbers::parse_literal(number_token.lexeme);
+}
+
+types::string decode_string(const token& string_token) {
+    return types::string(string_contents(string_token));
 }
 
 } // namespace pierogi::lexer
@@ -0,0 +1,85 @@
+#include "numbers.hpp"
+
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <limits>
+
+namespace pierogi::numbers {
+
+namespace {
+
+constexpr int mantissa_bits = std::numeric_limits<types::number>::digits;
+
+// The largest k for which 10^k = 2^k * 5^k is exactly representable, which is
+// when 5^k fits in the mantissa. Only computed up to what fits in 64 bits,
+// which undercounts for wider types but never overcounts.
+constexpr int make_max_exact_power() {
+    const uint64_t limit = mantissa_bits >= 64 ? std::numeric_limits<uint64_t>::max()
+                                               : (uint64_t(1) << mantissa_bits);
+    uint64_t power_of_five = 1;
+    int k = 0;
+    while (power_of_five <= limit / 5) {
+        power_of_five *= 5;
+        k++;
+    }
+    return k;
+}
+
+constexpr int max_exact_power = make_max_exact_power();
+
+constexpr std::array<types::number, max_exact_power + 1> make_exact_powers() {
+    std::array<types::number, max_exact_power + 1> powers{};
+    types::number power = 1;
+    for (auto& p : powers) {
+        p = power;
+        power *= 10;
+    }
+    return powers;
+}
+
+constexpr std::array<types::number, max_exact_power + 1> exact_powers = make_exact_powers();
+
+// Mantissas up to this value convert to types::number without rounding
+constexpr uint64_t max_exact_mantissa = mantissa_bits >= 64 ? std::numeric_limits<uint64_t>::max()
+                                                            : (uint64_t(1) << mantissa_bits);
+
+constexpr int max_mantissa_digits = std::numeric_limits<uint64_t>::digits10;
+
+types::number parse_slow(std::string_view literal) {
+    types::number value = 0;
+    std::from_chars(literal.data(), literal.data() + literal.size(), value);
+    return value;
+}
+
+} // namespace
+
+types::number parse_literal(std::string_view literal) {
+    const char* current = literal.data();
+    const char* const end = current + literal.size();
+
+    uint64_t mantissa = 0;
+    int significant_digits = 0;
+    for (; current != end && *current != '.'; current++) {
+        mantissa = mantissa * 10 + (*current - '0');
+        if (mantissa != 0) significant_digits++;
+    }
+    if (significant_digits > max_mantissa_digits) return parse_slow(literal);
+    if (current == end) return static_cast<types::number>(mantissa);
+
+    current++; // Skip '.'
+    int fraction_digits = static_cast<int>(end - current);
+    for (; current != end; current++) {
+        mantissa = mantissa * 10 + (*current - '0');
+        if (mantissa != 0) significant_digits++;
+    }
+    // Clinger's fast path: both operands are exact, so a single correctly
+    // rounded division gives the correctly rounded result
+    if (significant_digits <= max_mantissa_digits && fraction_digits <= max_exact_power &&
+        mantissa <= max_exact_mantissa) {
+        return static_cast<types::number>(mantissa) / exact_powers[fraction_digits];
+    }
+    return parse_slow(literal);
+}
+
+} // namespace pierogi::numbers
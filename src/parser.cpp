@@ -1,39 +1,601 @@
 #include "parser.hpp"
 
 #include <algorithm>
+#include <array>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
 
 namespace pierogi::parser {
 
-struct state {
-    const std::vector<lexer::token>& tokens;
-    errors::reporter_interface& error_reporter;
-    std::vector<ast::expression> expressions;
+namespace {
+
+// Binary operators from loosest to tightest. Prefix operators sit between
+// factors and exponents, so -2^2 is -(2^2) but -a * b is (-a) * b.
+enum precedence : uint8_t {
+    NONE,
+    DISJUNCTION,
+    CONJUNCTION,
+    EQUALITY,
+    CONSTRUCTION,
+    COMPARISON,
+    TERM,
+    FACTOR,
+    PREFIX,
+    EXPONENT
+};
+
+// How tightly a binary operator holds on to the operands on either side of
+// it. An operator only takes the expression to its left if it binds tighter
+// than whatever is waiting for that expression, so binding slightly tighter
+// on the right makes an operator left-associative, and slightly looser makes
+// it right-associative. Tokens that aren't binary operators bind with 0.
+struct binding_power {
+    uint8_t left = 0;
+    uint8_t right = 0;
+};
+
+constexpr auto binding_powers = [] {
+    std::array<binding_power, static_cast<size_t>(lexer::token_type::EOF_) + 1> powers{};
+    auto left_associative = [&](lexer::token_type type, precedence level) {
+        powers[static_cast<size_t>(type)] = {static_cast<uint8_t>(2 * level), static_cast<uint8_t>(2 * level + 1)};
+    };
+    auto right_associative = [&](lexer::token_type type, precedence level) {
+        powers[static_cast<size_t>(type)] = {static_cast<uint8_t>(2 * level + 1), static_cast<uint8_t>(2 * level)};
+    };
+    left_associative(lexer::token_type::OR, DISJUNCTION);
+    left_associative(lexer::token_type::AND, CONJUNCTION);
+    left_associative(lexer::token_type::EQUAL_EQUAL, EQUALITY);
+    left_associative(lexer::token_type::NOT_EQUAL, EQUALITY);
+    right_associative(lexer::token_type::COLON, CONSTRUCTION);
+    right_associative(lexer::token_type::DOT_DOT, CONSTRUCTION);
+    left_associative(lexer::token_type::LESS_THAN, COMPARISON);
+    left_associative(lexer::token_type::GREATER_THAN, COMPARISON);
+    left_associative(lexer::token_type::LESS_EQUAL, COMPARISON);
+    left_associative(lexer::token_type::GREATER_EQUAL, COMPARISON);
+    left_associative(lexer::token_type::PLUS, TERM);
+    left_associative(lexer::token_type::MINUS, TERM);
+    left_associative(lexer::token_type::ASTERISK, FACTOR);
+    left_associative(lexer::token_type::SLASH, FACTOR);
+    right_associative(lexer::token_type::CARET, EXPONENT);
+    return powers;
+}();
+
+// The operand of a prefix operator takes every binary operator that binds
+// tighter than the prefix operator itself
+constexpr uint8_t prefix_binding_power = 2 * PREFIX;
+
+// What a binary operator evaluates to when both its operands are known, or
+// nothing if it's better left for run time
+std::optional<types::value> evaluate_binary(lexer::token_type type, const types::value& lhs, const types::value& rhs) {
+    if (type == lexer::token_type::EQUAL_EQUAL || type == lexer::token_type::NOT_EQUAL) {
+        if (lhs.index() != rhs.index()) return std::nullopt;
+        bool equal;
+        if (auto n = std::get_if<types::number>(&lhs)) {
+            equal = *n == std::get<types::number>(rhs);
+        } else if (auto str = std::get_if<types::string>(&lhs)) {
+            equal = *str == std::get<types::string>(rhs);
+        } else if (auto b = std::get_if<types::boolean>(&lhs)) {
+            equal = *b == std::get<types::boolean>(rhs);
+        } else if (std::holds_alternative<types::nil_type>(lhs)) {
+            equal = true;
+        } else {
+            // Constant lists are left for run time
+            return std::nullopt;
+        }
+        return types::value(equal == (type == lexer::token_type::EQUAL_EQUAL));
+    }
+    if (type == lexer::token_type::AND || type == lexer::token_type::OR) {
+        auto a = std::get_if<types::boolean>(&lhs);
+        auto b = std::get_if<types::boolean>(&rhs);
+        if (!a || !b) return std::nullopt;
+        return types::value(type == lexer::token_type::AND ? *a && *b : *a || *b);
+    }
+    auto a = std::get_if<types::number>(&lhs);
+    auto b = std::get_if<types::number>(&rhs);
+    if (!a || !b) return std::nullopt;
+    types::number result;
+    switch (type) {
+    case lexer::token_type::LESS_THAN:
+        return types::value(*a < *b);
+    case lexer::token_type::GREATER_THAN:
+        return types::value(*a > *b);
+    case lexer::token_type::LESS_EQUAL:
+        return types::value(*a <= *b);
+    case lexer::token_type::GREATER_EQUAL:
+        return types::value(*a >= *b);
+    case lexer::token_type::PLUS:
+        result = *a + *b;
+        break;
+    case lexer::token_type::MINUS:
+        result = *a - *b;
+        break;
+    case lexer::token_type::ASTERISK:
+        result = *a * *b;
+        break;
+    case lexer::token_type::SLASH:
+        if (*b == 0) return std::nullopt;
+        result = *a / *b;
+        break;
+    case lexer::token_type::CARET:
+        result = std::pow(*a, *b);
+        break;
+    default:
+        return std::nullopt;
+    }
+    // Overflow and NaN are for run time to deal with
+    if (!std::isfinite(result)) return std::nullopt;
+    return types::value(result);
+}
+
+std::optional<types::value> evaluate_prefix(lexer::token_type type, const types::value& operand) {
+    if (type == lexer::token_type::NOT) {
+        if (auto b = std::get_if<types::boolean>(&operand)) return types::value(!*b);
+        return std::nullopt;
+    }
+    if (auto n = std::get_if<types::number>(&operand)) return types::value(-*n);
+    return std::nullopt;
+}
+
+// The value of a literal token, or nothing if it isn't one
+std::optional<types::value> decode_literal(const lexer::token& literal) {
+    switch (literal.type) {
+    case lexer::token_type::NIL:
+        return types::value(std::nullopt);
+    case lexer::token_type::TRUE:
+        return types::value(true);
+    case lexer::token_type::FALSE:
+        return types::value(false);
+    case lexer::token_type::NUMBER:
+        return types::value(lexer::decode_number(literal));
+    case lexer::token_type::STRING:
+        return types::value(lexer::decode_string(literal));
+    default:
+        return std::nullopt;
+    }
+}
+
+// An error found while parsing part of a big list, held back until the
+// main thread knows the serial parser would have found it too
+struct held_error {
+    errors::error_type type;
+    lexer::token near;
+};
+
+// Threads kept for a whole parse, so that each big list in it doesn't pay
+// for starting threads of its own
+class thread_pool {
+public:
+    // The thread that calls run() counts as one of `thread_count`
+    explicit thread_pool(size_t thread_count) {
+        for (size_t i = 1; i < thread_count; i++) threads.emplace_back([this] { work(); });
+    }
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    ~thread_pool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        woken.notify_all();
+        for (std::thread& thread : threads) thread.join();
+    }
+
+    [[nodiscard]] size_t size() const {
+        return threads.size() + 1;
+    }
+
+    // Calls task(i) for every i below task_count, on the pool's threads and
+    // the calling one, and returns once every call has
+    void run(size_t task_count, const std::function<void(size_t)>& task) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            current_task = &task;
+            next_task = 0;
+            this->task_count = unfinished_tasks = task_count;
+            generation++;
+        }
+        woken.notify_all();
+        run_tasks();
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [this] { return unfinished_tasks == 0; });
+    }
+
+private:
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable woken, finished;
+    const std::function<void(size_t)>* current_task = nullptr;
+    size_t task_count = 0, next_task = 0, unfinished_tasks = 0;
+    // Counts calls to run(), so a thread can tell new tasks from ones it has
+    // already been woken for
+    uint64_t generation = 0;
+    bool stopping = false;
+
+    void work() {
+        uint64_t seen_generation = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            woken.wait(lock, [&] { return stopping || generation != seen_generation; });
+            if (stopping) return;
+            seen_generation = generation;
+            lock.unlock();
+            run_tasks();
+            lock.lock();
+        }
+    }
+
+    void run_tasks() {
+        while (true) {
+            size_t index;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (next_task == task_count) return;
+                index = next_task++;
+            }
+            (*current_task)(index);
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--unfinished_tasks == 0) finished.notify_all();
+        }
+    }
+};
+
+} // namespace
+
+// Walks a token buffer that was lexed up front, reading its type array
+// directly and only building token views for the literals it consumes
+struct buffered_tokens {
+    const lexer::token_buffer& tokens;
     size_t current_token_index = 0;
 
-    state(const std::vector<lexer::token>& tokens,
-          errors::reporter_interface& error_reporter)
-        : tokens(tokens), error_reporter(error_reporter) {}
+    explicit buffered_tokens(const lexer::token_buffer& tokens) : tokens(tokens) {}
 
-    [[nodiscard]] bool at_end() const {
-        return peek_current().type == lexer::token_type::EOF_;
+    [[nodiscard]] lexer::token_type peek_current_type() const {
+        return tokens.type(current_token_index);
     }
 
-    [[nodiscard]] const lexer::token& peek_current() const {
+    [[nodiscard]] lexer::token peek_current() const {
         return tokens[current_token_index];
     }
 
-    const lexer::token& consume_current() {
-        if (!at_end()) current_token_index++;
-        return peek_previous();
+    [[nodiscard]] lexer::token peek_previous() const {
+        return tokens[current_token_index - 1];
+    }
+
+    [[nodiscard]] std::string_view source() const {
+        return tokens.source();
+    }
+
+    [[nodiscard]] const std::shared_ptr<symbols::symbol_table>& symbols() const {
+        return tokens.symbols();
+    }
+
+    void advance() {
+        current_token_index++;
+    }
+};
+
+// Pulls tokens from the lexer as the parser reaches them
+struct streamed_tokens {
+    lexer::token_stream& stream;
+
+    explicit streamed_tokens(lexer::token_stream& stream) : stream(stream) {}
+
+    [[nodiscard]] lexer::token_type peek_current_type() const {
+        return stream.peek().type;
+    }
+
+    [[nodiscard]] const lexer::token& peek_current() const {
+        return stream.peek();
     }
 
     [[nodiscard]] const lexer::token& peek_previous() const {
-        return tokens[current_token_index - 1];
+        return stream.previous();
+    }
+
+    [[nodiscard]] std::string_view source() const {
+        return stream.source();
+    }
+
+    [[nodiscard]] const std::shared_ptr<symbols::symbol_table>& symbols() const {
+        return stream.symbols();
+    }
+
+    void advance() {
+        stream.advance();
+    }
+};
+
+// Builds the tree out of nodes in an arena that point at each other
+struct pointer_builder {
+    using node = ast::expression;
+    ast::module module;
+
+    template <typename TNode, typename... TArgs>
+    node make(TArgs&&... args) {
+        return module.nodes->create<TNode>(std::forward<TArgs>(args)...);
+    }
+
+    node make_list(const node* first, const node* last) {
+        return make<ast::list>(module.nodes->copy<ast::expression>(first, last));
+    }
+
+    // Tells nodes apart, by address
+    [[nodiscard]] static uint64_t identity(node n) {
+        return std::visit([](auto pointer) { return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(pointer)); }, n);
+    }
+
+    [[nodiscard]] arena::span<ast::expression> list_contents(node list) const {
+        return std::get<ast::list_pointer>(list)->contents;
+    }
+
+    // The value of a literal node, or nothing if it isn't one. A negated
+    // number counts, since that's how negative numbers are written.
+    [[nodiscard]] std::optional<types::value> literal_value(node n) const {
+        if (std::holds_alternative<ast::nil_pointer>(n)) return types::value(std::nullopt);
+        if (std::holds_alternative<ast::true_boolean_pointer>(n)) return types::value(true);
+        if (std::holds_alternative<ast::false_boolean_pointer>(n)) return types::value(false);
+        if (auto number = std::get_if<ast::number_pointer>(&n)) return (*number)->value;
+        if (auto string = std::get_if<ast::string_pointer>(&n)) return (*string)->value;
+        if (auto negation = std::get_if<ast::arithmetic_negation_pointer>(&n)) {
+            if (auto number = std::get_if<ast::number_pointer>(&(*negation)->inside)) return -(*number)->value;
+        }
+        return {};
+    }
+};
+
+// Builds the tree into a flat array of nodes that refer to each other by index
+struct flat_builder {
+    using node = flat_ast::node_index;
+    flat_ast::module module;
+
+    template <typename TNode, typename... TArgs>
+    node make(TArgs&&... args) {
+        return module.add<TNode>(std::forward<TArgs>(args)...);
+    }
+
+    node make_list(const node* first, const node* last) {
+        return module.add<ast::list>(arena::span<const node>(first, last - first));
+    }
+
+    [[nodiscard]] static uint64_t identity(node n) {
+        return n;
+    }
+
+    [[nodiscard]] arena::span<const node> list_contents(node list) const {
+        return module.get<ast::list>(list).contents;
+    }
+
+    [[nodiscard]] std::optional<types::value> literal_value(node n) const {
+        switch (module.kind_at(n)) {
+        case flat_ast::kind::nil:
+            return types::value(std::nullopt);
+        case flat_ast::kind::true_boolean:
+            return types::value(true);
+        case flat_ast::kind::false_boolean:
+            return types::value(false);
+        case flat_ast::kind::number:
+            return module.get<ast::number>(n).value;
+        case flat_ast::kind::string:
+            return module.get<ast::string>(n).value;
+        case flat_ast::kind::arithmetic_negation: {
+            node inside = module.get<ast::arithmetic_negation>(n).inside;
+            if (module.kind_at(inside) == flat_ast::kind::number) return -module.get<ast::number>(inside).value;
+            return {};
+        }
+        default:
+            return {};
+        }
+    }
+};
+
+// Every node made so far, found by what it holds, so that a node identical to
+// one made before can be shared instead of made again. Nodes are identified
+// by kind and children, so that finding one doesn't have to walk the subtrees
+// under it, and children are compared by identity. That's enough because
+// identical children have already been shared by the time their parent is
+// made.
+template <typename TBuilder>
+class subtree_table {
+public:
+    using node = typename TBuilder::node;
+
+    template <typename TNode, typename... TArgs>
+    node make(TBuilder& builder, const TArgs&... args) {
+        auto make_node = [&] { return builder.template make<TNode>(args...); };
+        if constexpr (std::is_same_v<TNode, ast::number>) {
+            return find_or_make(numbers, args..., make_node);
+        } else if constexpr (std::is_same_v<TNode, ast::string>) {
+            return find_or_make(strings, args..., make_node);
+        } else if constexpr (std::is_same_v<TNode, ast::list> || std::is_same_v<TNode, ast::constant_list>) {
+            // Lists are shared through make_list. Constant lists are data,
+            // which rarely repeats, and expensive to compare.
+            return make_node();
+        } else {
+            return find_or_make(shapes, shape{flat_ast::view<TNode>::tag, {identity_of(args)...}}, make_node);
+        }
+    }
+
+    node make_list(TBuilder& builder, const node* first, const node* last) {
+        uint64_t hash = static_cast<uint64_t>(last - first);
+        for (const node* element = first; element != last; element++) {
+            hash = hash * 0x100000001b3 ^ TBuilder::identity(*element);
+        }
+        auto [candidate, candidates_end] = lists.equal_range(hash);
+        for (; candidate != candidates_end; ++candidate) {
+            auto contents = builder.list_contents(candidate->second);
+            if (std::equal(first, last, contents.begin(), contents.end(), [](node a, node b) {
+                return TBuilder::identity(a) == TBuilder::identity(b);
+            })) {
+                return candidate->second;
+            }
+        }
+        node list = builder.make_list(first, last);
+        lists.emplace(hash, list);
+        return list;
+    }
+
+private:
+    // A node that isn't a literal or a list: its kind and the identities of
+    // its children, or its symbol
+    struct shape {
+        flat_ast::kind kind;
+        std::array<uint64_t, 2> operands;
+
+        bool operator==(const shape& other) const {
+            return kind == other.kind && operands == other.operands;
+        }
+    };
+
+    struct shape_hash {
+        size_t operator()(const shape& s) const {
+            uint64_t hash = static_cast<uint64_t>(s.kind);
+            for (uint64_t operand : s.operands) hash = hash * 0x100000001b3 ^ operand;
+            return static_cast<size_t>(hash ^ hash >> 32);
+        }
+    };
+
+    // 0 and -0 are different literals
+    struct same_number {
+        bool operator()(types::number a, types::number b) const {
+            return a == b && std::signbit(a) == std::signbit(b);
+        }
+    };
+
+    std::unordered_map<shape, node, shape_hash> shapes;
+    std::unordered_map<types::number, node, std::hash<types::number>, same_number> numbers;
+    std::unordered_map<types::string, node> strings;
+    // Lists by a hash of their elements' identities
+    std::unordered_multimap<uint64_t, node> lists;
+
+    template <typename T>
+    static uint64_t identity_of(const T& operand) {
+        if constexpr (std::is_integral_v<T>) {
+            return operand;
+        } else {
+            return TBuilder::identity(operand);
+        }
+    }
+
+    template <typename TMap, typename TKey, typename TMake>
+    static node find_or_make(TMap& map, const TKey& key, TMake make_node) {
+        auto found = map.find(key);
+        if (found != map.end()) return found->second;
+        node made = make_node();
+        map.emplace(key, made);
+        return made;
+    }
+};
+
+// Something the parser has started but can't finish until the expression
+// it's in the middle of is done
+enum class frame_kind : uint8_t {
+    // A binary operator waiting for its right-hand operand
+    BINARY,
+    // A prefix operator waiting for its operand
+    PREFIX,
+    // A '(' waiting for the expression inside it and its ')'
+    GROUP,
+    // A '[' waiting for its next element
+    LIST
+};
+
+template <typename TNode>
+struct frame {
+    frame_kind kind;
+    lexer::token_type operator_type;
+    // The binding power the expression around this one was parsed with
+    uint8_t min_binding_power;
+    TNode lhs;
+    // Where a list's elements start in list_elements
+    size_t first_element;
+};
+
+template <typename TTokens, typename TBuilder>
+struct state {
+    using node = typename TBuilder::node;
+
+    TTokens tokens;
+    errors::reporter_interface& error_reporter;
+    const parse_options& options;
+    TBuilder builder;
+    // Everything that's open around the current expression, innermost last.
+    // Keeping it on the heap instead of recursing means nesting is only
+    // limited by memory (and options.max_depth).
+    std::vector<frame<node>> frames;
+    // The elements of every list being parsed, innermost last. Each list
+    // takes its own off the top once it's closed.
+    std::vector<node> list_elements;
+    // Only built once there's an error to report
+    std::optional<source::line_index> lines;
+    // Only when options.share_identical_subtrees is set
+    std::optional<subtree_table<TBuilder>> subtrees;
+    // The ']' of the last list that couldn't be parsed in parallel. Lists
+    // nested in it are parsed serially too, rather than tried again.
+    size_t serial_until = 0;
+    // Only set on the states that parse part of a big list, which hold their
+    // errors back instead of reporting them
+    std::vector<held_error>* held_errors = nullptr;
+    // How far give_up() skips with a token buffer. Parts of a big list stop
+    // at its ']'.
+    size_t give_up_index = SIZE_MAX;
+    // Only started once there's a list big enough to need it
+    std::optional<thread_pool> pool;
+
+    state(TTokens tokens,
+          errors::reporter_interface& error_reporter,
+          const parse_options& options)
+        : tokens(tokens), error_reporter(error_reporter), options(options) {}
+
+    template <typename TNode, typename... TArgs>
+    node make(TArgs&&... args) {
+        if (subtrees) return subtrees->template make<TNode>(builder, args...);
+        return builder.template make<TNode>(std::forward<TArgs>(args)...);
+    }
+
+    [[nodiscard]] bool at_end() const {
+        return peek_current_type() == lexer::token_type::EOF_;
+    }
+
+    [[nodiscard]] lexer::token_type peek_current_type() const {
+        return tokens.peek_current_type();
+    }
+
+    void consume_current() {
+        if (!at_end()) tokens.advance();
+    }
+
+    [[nodiscard]] decltype(auto) peek_current() const {
+        return tokens.peek_current();
+    }
+
+    [[nodiscard]] decltype(auto) peek_previous() const {
+        return tokens.peek_previous();
+    }
+
+    void report_error(errors::error_type type, const lexer::token& near) {
+        if (held_errors) {
+            held_errors->push_back({type, near});
+            return;
+        }
+        if (!lines) lines.emplace(tokens.source());
+        auto where = lines->locate(near.offset);
+        error_reporter.report(type, near.lexeme, where.line, where.column);
     }
 
     [[nodiscard]] bool check(lexer::token_type type) const {
         if (at_end()) return false;
-        return peek_current().type == type;
+        return peek_current_type() == type;
     }
 
     bool matches_current(lexer::token_type type) {
@@ -44,9 +606,12 @@ struct state {
         return false;
     }
 
-    lexer::token consume_if_matches(lexer::token_type type, const std::string& message) {
-        if (check(type)) return consume_current();
-        // TODO: report error here
+    // Reports the current token if it isn't the `type` expected there, and
+    // leaves it for whatever comes next
+    bool consume_if_matches(lexer::token_type type) {
+        if (matches_current(type)) return true;
+        report_error(errors::error_type::UNEXPECTED_TOKEN, peek_current());
+        return false;
     }
 
     void parse_tokens() {
@@ -54,140 +619,391 @@ struct state {
     }
 
     void parse_next_expression() {
-        expressions.push_back(parse_expression());
+        builder.module.expressions.push_back(parse_expression());
     }
 
-    ast::expression parse_expression() {
-        return parse_equality();
-    }
-
-    ast::expression parse_equality() {
-        ast::expression expression = parse_comparison();
+    // Parses with precedence climbing, but where a recursive parser would
+    // call itself for an operand, this pushes a frame for whatever's waiting
+    // on that operand and goes around again. Once an operand is complete, it
+    // either becomes the left-hand side of the next operator, if that binds
+    // tightly enough, or finishes off the innermost frame.
+    node parse_expression() {
+        uint8_t min_binding_power = 0;
+        node expression{};
         while (true) {
-            if (matches_current(lexer::token_type::EQUAL_EQUAL)) {
-                expression = std::make_shared<ast::equals>(expression, parse_comparison());
+            // Open everything that comes before the next operand
+            if (frames.size() > options.max_depth) return give_up();
+            if (matches_current(lexer::token_type::MINUS) || matches_current(lexer::token_type::NOT)) {
+                frames.push_back({frame_kind::PREFIX, peek_previous().type, min_binding_power, {}, 0});
+                min_binding_power = prefix_binding_power;
                 continue;
             }
-            if (matches_current(lexer::token_type::NOT_EQUAL)) {
-                expression = std::make_shared<ast::not_equals>(expression, parse_comparison());
+            if (matches_current(lexer::token_type::LEFT_PARENTHESIS)) {
+                frames.push_back({frame_kind::GROUP, lexer::token_type::LEFT_PARENTHESIS, min_binding_power, {}, 0});
+                min_binding_power = 0;
                 continue;
             }
-            break;
+            if (matches_current(lexer::token_type::LEFT_SQUARE_BRACKET)) {
+                // A parallel attempt can leave the elements it got through
+                size_t first_element = list_elements.size();
+                if (matches_current(lexer::token_type::RIGHT_SQUARE_BRACKET)) {
+                    expression = make_list(nullptr, nullptr);
+                } else if (auto constant = parse_literal_list()) {
+                    expression = *constant;
+                } else if (auto list = parse_list_in_parallel()) {
+                    expression = *list;
+                } else {
+                    frames.push_back({frame_kind::LIST, lexer::token_type::LEFT_SQUARE_BRACKET, min_binding_power, {},
+                                      first_element});
+                    min_binding_power = 0;
+                    continue;
+                }
+            } else {
+                expression = parse_primary();
+            }
+
+            // Close everything the operand completes
+            bool needs_operand = false;
+            while (!needs_operand) {
+                binding_power power = binding_powers[static_cast<size_t>(peek_current_type())];
+                if (power.left > min_binding_power) {
+                    lexer::token_type type = peek_current_type();
+                    consume_current();
+                    frames.push_back({frame_kind::BINARY, type, min_binding_power, expression, 0});
+                    min_binding_power = power.right;
+                    needs_operand = true;
+                    continue;
+                }
+                if (frames.empty()) return expression;
+                frame<node> innermost = frames.back();
+                frames.pop_back();
+                min_binding_power = innermost.min_binding_power;
+                switch (innermost.kind) {
+                case frame_kind::BINARY:
+                    expression = make_binary(innermost.operator_type, innermost.lhs, expression);
+                    break;
+                case frame_kind::PREFIX:
+                    expression = make_prefix(innermost.operator_type, expression);
+                    break;
+                case frame_kind::GROUP:
+                    consume_if_matches(lexer::token_type::RIGHT_PARENTHESIS);
+                    expression = make_group(expression);
+                    break;
+                case frame_kind::LIST:
+                    list_elements.push_back(expression);
+                    if (matches_current(lexer::token_type::COMMA)) {
+                        frames.push_back(innermost);
+                        min_binding_power = 0;
+                        needs_operand = true;
+                        break;
+                    }
+                    consume_if_matches(lexer::token_type::RIGHT_SQUARE_BRACKET);
+                    expression = make_list(list_elements.data() + innermost.first_element,
+                                           list_elements.data() + list_elements.size());
+                    list_elements.resize(innermost.first_element);
+                    break;
+                }
+            }
         }
-        return expression;
     }
 
-    // TODO: add construction and concat operators (tentatively) between comparisons and equalities
+    node make_list(const node* first, const node* last) {
+        if (auto constant = fold_list(first, last)) return *constant;
+        if (subtrees) return subtrees->make_list(builder, first, last);
+        return builder.make_list(first, last);
+    }
 
-    ast::expression parse_comparison() {
-        ast::expression expression = parse_term();
-        while (true) {
-            if (matches_current(lexer::token_type::LESS_THAN)) {
-                expression = std::make_shared<ast::less_than>(expression, parse_term());
-                continue;
-            }
-            if (matches_current(lexer::token_type::GREATER_THAN)) {
-                expression = std::make_shared<ast::greater_than>(expression, parse_term());
-                continue;
-            }
-            if (matches_current(lexer::token_type::LESS_EQUAL)) {
-                expression = std::make_shared<ast::less_equal>(expression, parse_term());
-                continue;
-            }
-            if (matches_current(lexer::token_type::GREATER_EQUAL)) {
-                expression = std::make_shared<ast::greater_equal>(expression, parse_term());
-                continue;
-            }
-            break;
+    // A constant list of the elements' values, if they're all literals
+    std::optional<node> fold_list(const node* first, const node* last) {
+        if (!options.fold_literal_lists || first == last) return std::nullopt;
+        std::vector<types::value> values;
+        values.reserve(last - first);
+        for (const node* element = first; element != last; element++) {
+            auto value = builder.literal_value(*element);
+            if (!value) return std::nullopt;
+            values.push_back(std::move(*value));
         }
-        return expression;
+        return make<ast::constant_list>(types::list(values));
     }
 
-    ast::expression parse_term() {
-        ast::expression expression = parse_factor();
-        while (true) {
-            if (matches_current(lexer::token_type::PLUS)) {
-                expression = std::make_shared<ast::addition>(expression, parse_factor());
-                continue;
-            }
-            if (matches_current(lexer::token_type::MINUS)) {
-                expression = std::make_shared<ast::subtraction>(expression, parse_factor());
-                continue;
+    // Folds a list of nothing but literals, whose '[' was just consumed,
+    // straight out of the tokens, without making nodes for its elements
+    // first. Lists of anything else are left alone.
+    std::optional<node> parse_literal_list() {
+        // Only token buffers know where the list ends ahead of time
+        if constexpr (std::is_same_v<TTokens, buffered_tokens>) {
+            // The serial parser reports a list nested too deep on its own frame
+            if (!options.fold_literal_lists || frames.size() + 1 > options.max_depth) return std::nullopt;
+            const lexer::token_buffer& buffer = tokens.tokens;
+            size_t open = tokens.current_token_index - 1;
+            uint32_t close = buffer.partner(open);
+            if (close == lexer::token_buffer::no_partner) return std::nullopt;
+            // Numbers stay packed until something else turns up
+            std::vector<types::number> numbers;
+            std::vector<types::value> values;
+            // Literals, each maybe a negated number, and commas have to
+            // alternate, ending in a literal
+            for (size_t i = open + 1;; i++) {
+                bool negated = buffer.type(i) == lexer::token_type::MINUS &&
+                               buffer.type(i + 1) == lexer::token_type::NUMBER;
+                if (negated) i++;
+                auto value = decode_literal(buffer[i]);
+                if (!value) return std::nullopt;
+                if (auto number = std::get_if<types::number>(&*value); number && values.empty()) {
+                    numbers.push_back(negated ? -*number : *number);
+                } else {
+                    if (values.empty()) values.assign(numbers.begin(), numbers.end());
+                    values.push_back(negated ? types::value(-std::get<types::number>(*value)) : std::move(*value));
+                }
+                if (++i == close) break;
+                if (buffer.type(i) != lexer::token_type::COMMA || i + 1 == close) return std::nullopt;
             }
-            break;
+            tokens.current_token_index = close + 1;
+            if (values.empty()) return make<ast::constant_list>(types::list(std::move(numbers)));
+            return make<ast::constant_list>(types::list(values));
+        } else {
+            return std::nullopt;
         }
-        return expression;
     }
 
-    ast::expression parse_factor() {
-        ast::expression expression = parse_unary();
-        while (true) {
-            if (matches_current(lexer::token_type::ASTERISK)) {
-                expression = std::make_shared<ast::multiplication>(expression, parse_unary());
-                continue;
+    // Parses the elements of a big list, whose '[' was just consumed, on
+    // several threads. Each thread builds into an arena of its own, which the
+    // module adopts afterwards, and writes its elements straight into the
+    // list's contents. Errors an element recovers from by itself are reported
+    // afterwards in order. Once an element doesn't end right at its comma,
+    // the serial parser would have parsed the list differently from there,
+    // so this leaves the elements before it in list_elements and the rest of
+    // the list to the serial parser.
+    std::optional<node> parse_list_in_parallel() {
+        // Elements are found by jumping over bracket pairs, which only token
+        // buffers know, and flat nodes would all need renumbering to combine
+        if constexpr (std::is_same_v<TTokens, buffered_tokens> && std::is_same_v<TBuilder, pointer_builder>) {
+            const lexer::token_buffer& buffer = tokens.tokens;
+            size_t open = tokens.current_token_index - 1;
+            uint32_t close = buffer.partner(open);
+            if (close == lexer::token_buffer::no_partner || close - open - 1 < options.min_parallel_list_tokens ||
+                open < serial_until) {
+                return std::nullopt;
             }
-            if (matches_current(lexer::token_type::SLASH)) {
-                expression = std::make_shared<ast::division>(expression, parse_unary());
-                continue;
+            size_t thread_count = options.thread_count != 0 ? options.thread_count : std::thread::hardware_concurrency();
+            // The serial parser would fail on the list's own frame
+            if (thread_count <= 1 || frames.size() + 1 > options.max_depth) return std::nullopt;
+            // Threads couldn't share subtrees with each other or with the rest
+            // of the tree, so lists sharing them are parsed serially
+            if (options.share_identical_subtrees) return std::nullopt;
+
+            // The comma or ']' after each element
+            std::vector<uint32_t> element_ends;
+            for (size_t i = open + 1; i < close; i++) {
+                uint32_t partner = buffer.partner(i);
+                if (partner != lexer::token_buffer::no_partner && partner > i) {
+                    i = partner;
+                } else if (buffer.type(i) == lexer::token_type::COMMA) {
+                    element_ends.push_back(static_cast<uint32_t>(i));
+                }
+            }
+            element_ends.push_back(close);
+            if (element_ends.size() < 2) return std::nullopt;
+            if (!pool) pool.emplace(thread_count);
+
+            parse_options worker_options = options;
+            worker_options.max_depth = options.max_depth - (frames.size() + 1);
+            worker_options.thread_count = 1;
+            auto contents = builder.module.nodes->template create_array<ast::expression>(element_ends.size());
+            struct batch {
+                size_t first_element;
+                size_t last_element;
+                pointer_builder builder;
+                std::vector<held_error> errors;
+                // How many of its elements ended right at their comma
+                size_t parsed_count = 0;
+                bool gave_up = false;
+            };
+            std::vector<batch> batches(std::min(pool->size(), element_ends.size()));
+            for (size_t i = 0; i < batches.size(); i++) {
+                batches[i].first_element = i * element_ends.size() / batches.size();
+                batches[i].last_element = (i + 1) * element_ends.size() / batches.size();
             }
-            break;
+            pool->run(batches.size(), [&](size_t index) {
+                batch& b = batches[index];
+                state<buffered_tokens, pointer_builder> worker(buffered_tokens(buffer), error_reporter, worker_options);
+                worker.held_errors = &b.errors;
+                worker.give_up_index = close;
+                worker.tokens.current_token_index = b.first_element == 0 ? open + 1 : element_ends[b.first_element - 1] + 1;
+                for (size_t i = b.first_element; i < b.last_element; i++) {
+                    size_t errors_before = b.errors.size();
+                    contents[i] = worker.parse_expression();
+                    b.gave_up = !b.errors.empty() && b.errors.back().type == errors::error_type::NESTING_TOO_DEEP;
+                    if (b.gave_up) break;
+                    if (worker.tokens.current_token_index != element_ends[i]) {
+                        // The serial parser reports this element's errors itself
+                        b.errors.erase(b.errors.begin() + errors_before, b.errors.end());
+                        break;
+                    }
+                    worker.tokens.current_token_index++;
+                    b.parsed_count++;
+                }
+                b.builder = std::move(worker.builder);
+            });
+
+            for (batch& b : batches) builder.module.nodes->adopt(std::move(*b.builder.module.nodes));
+            for (const batch& b : batches) {
+                for (const held_error& error : b.errors) report_error(error.type, error.near);
+                // The serial parser would have given up at the same token
+                if (b.gave_up) return skip_rest();
+                if (b.parsed_count < b.last_element - b.first_element) {
+                    size_t parsed_count = b.first_element + b.parsed_count;
+                    list_elements.insert(list_elements.end(), contents.begin(), contents.begin() + parsed_count);
+                    tokens.current_token_index = parsed_count == 0 ? open + 1 : element_ends[parsed_count - 1] + 1;
+                    serial_until = close;
+                    return std::nullopt;
+                }
+            }
+            tokens.current_token_index = close + 1;
+            if (auto constant = fold_list(contents.begin(), contents.end())) return *constant;
+            return make<ast::list>(contents);
+        } else {
+            return std::nullopt;
         }
-        return expression;
     }
 
-    ast::expression parse_unary() {
-        if (matches_current(lexer::token_type::MINUS)) {
-            return std::make_shared<ast::arithmetic_negation>(parse_unary());
-        }
-        if (matches_current(lexer::token_type::NOT)) {
-            return std::make_shared<ast::logical_negation>(parse_unary());
-        }
-        return parse_primary();
+    // Reports that the source nests deeper than options.max_depth and skips
+    // the rest of it, since there's no telling where the nesting ends
+    node give_up() {
+        report_error(errors::error_type::NESTING_TOO_DEEP, peek_current());
+        return skip_rest();
     }
 
-    ast::expression parse_primary() {
-        if (matches_current(lexer::token_type::NIL)) {
-            return std::make_shared<ast::nil>();
-        }
-        if (matches_current(lexer::token_type::TRUE)) {
-            return std::make_shared<ast::true_boolean>();
+    node skip_rest() {
+        if constexpr (std::is_same_v<TTokens, buffered_tokens>) {
+            tokens.current_token_index = std::min(give_up_index, tokens.tokens.size() - 1);
+        } else {
+            while (!at_end()) consume_current();
         }
-        if (matches_current(lexer::token_type::FALSE)) {
-            return std::make_shared<ast::false_boolean>();
+        frames.clear();
+        list_elements.clear();
+        return make<ast::nil>();
+    }
+
+    node make_group(node inside) {
+        if (options.fold_constants && builder.literal_value(inside)) return inside;
+        return make<ast::group>(inside);
+    }
+
+    // Makes the node for whatever literal `value` is
+    node make_literal(types::value value) {
+        if (std::holds_alternative<types::nil_type>(value)) return make<ast::nil>();
+        if (auto b = std::get_if<types::boolean>(&value)) {
+            return *b ? make<ast::true_boolean>() : make<ast::false_boolean>();
         }
-        if (matches_current(lexer::token_type::NUMBER)) {
-            return std::make_shared<ast::number>(std::get<types::number>(peek_previous().value));
+        if (auto n = std::get_if<types::number>(&value)) return make<ast::number>(*n);
+        if (auto s = std::get_if<types::string>(&value)) return make<ast::string>(std::move(*s));
+        return make<ast::constant_list>(std::move(std::get<types::list>(value)));
+    }
+
+    node make_binary(lexer::token_type type, node lhs, node rhs) {
+        if (options.fold_constants) {
+            auto a = builder.literal_value(lhs);
+            auto b = a ? builder.literal_value(rhs) : std::nullopt;
+            if (b) {
+                if (auto folded = evaluate_binary(type, *a, *b)) return make_literal(*folded);
+            }
         }
-        if (matches_current(lexer::token_type::STRING)) {
-            return std::make_shared<ast::string>(std::get<types::string>(peek_previous().value));
+        switch (type) {
+        case lexer::token_type::OR:
+            return make<ast::disjunction>(lhs, rhs);
+        case lexer::token_type::AND:
+            return make<ast::conjunction>(lhs, rhs);
+        case lexer::token_type::EQUAL_EQUAL:
+            return make<ast::equals>(lhs, rhs);
+        case lexer::token_type::NOT_EQUAL:
+            return make<ast::not_equals>(lhs, rhs);
+        case lexer::token_type::COLON:
+            return make<ast::construction>(lhs, rhs);
+        case lexer::token_type::DOT_DOT:
+            return make<ast::concatenation>(lhs, rhs);
+        case lexer::token_type::LESS_THAN:
+            return make<ast::less_than>(lhs, rhs);
+        case lexer::token_type::GREATER_THAN:
+            return make<ast::greater_than>(lhs, rhs);
+        case lexer::token_type::LESS_EQUAL:
+            return make<ast::less_equal>(lhs, rhs);
+        case lexer::token_type::GREATER_EQUAL:
+            return make<ast::greater_equal>(lhs, rhs);
+        case lexer::token_type::PLUS:
+            return make<ast::addition>(lhs, rhs);
+        case lexer::token_type::MINUS:
+            return make<ast::subtraction>(lhs, rhs);
+        case lexer::token_type::ASTERISK:
+            return make<ast::multiplication>(lhs, rhs);
+        case lexer::token_type::SLASH:
+            return make<ast::division>(lhs, rhs);
+        case lexer::token_type::CARET:
+            return make<ast::exponentiation>(lhs, rhs);
+        default:
+            // Only tokens with a binding power get here, and each has a case
+            throw std::logic_error("No node for a binary operator");
         }
-        if (matches_current(lexer::token_type::LEFT_SQUARE_BRACKET)) {
-            std::vector<ast::expression> contents;
-            if (matches_current(lexer::token_type::RIGHT_SQUARE_BRACKET)) {
-                return std::make_shared<ast::list>(contents);
-            }
-            do {
-                contents.push_back(parse_expression());
-            } while (matches_current(lexer::token_type::COMMA));
-            if (!matches_current(lexer::token_type::RIGHT_SQUARE_BRACKET)) {
-                // TODO: throw error for unclosed list
+    }
+
+    node make_prefix(lexer::token_type type, node operand) {
+        if (options.fold_constants) {
+            if (auto value = builder.literal_value(operand)) {
+                if (auto folded = evaluate_prefix(type, *value)) return make_literal(*folded);
             }
-            return std::make_shared<ast::list>(contents);
         }
-        if (matches_current(lexer::token_type::LEFT_PARENTHESIS)) {
-            ast::expression expression = parse_expression();
-            consume_if_matches(lexer::token_type::RIGHT_PARENTHESIS, "Expected closing ')' after expression");
-            return std::make_shared<ast::group>(expression);
+        if (type == lexer::token_type::NOT) return make<ast::logical_negation>(operand);
+        return make<ast::arithmetic_negation>(operand);
+    }
+
+    // Parses an operand that doesn't nest
+    node parse_primary() {
+        if (auto value = decode_literal(peek_current())) {
+            consume_current();
+            return make_literal(std::move(*value));
         }
-        // TODO: throw an error here since we haven't matched with anything
+        if (matches_current(lexer::token_type::IDENTIFIER)) {
+            return make<ast::identifier>(peek_previous().symbol);
+        }
+        // Skip the token so parsing can go on, leaving nil in place of the
+        // expression that should have started there
+        report_error(errors::error_type::UNEXPECTED_TOKEN, peek_current());
+        consume_current();
+        return make<ast::nil>();
     }
 };
 
-std::vector<ast::expression> create_ast(const std::vector<lexer::token>& tokens,
-                                        errors::reporter_interface& error_reporter) {
-    state parser(tokens, error_reporter);
+template <typename TBuilder, typename TTokens>
+auto parse(TTokens tokens, errors::reporter_interface& error_reporter, const parse_options& options) {
+    state<TTokens, TBuilder> parser(tokens, error_reporter, options);
+    parser.builder.module.symbol_names = tokens.symbols();
+    if (options.share_identical_subtrees) parser.subtrees.emplace();
     parser.parse_tokens();
-    return parser.expressions;
+    return std::move(parser.builder.module);
+}
+
+ast::module create_ast(const lexer::token_buffer& tokens,
+                       errors::reporter_interface& error_reporter,
+                       const parse_options& options) {
+    return parse<pointer_builder>(buffered_tokens(tokens), error_reporter, options);
+}
+
+ast::module create_ast(lexer::token_stream& tokens,
+                       errors::reporter_interface& error_reporter,
+                       const parse_options& options) {
+    return parse<pointer_builder>(streamed_tokens(tokens), error_reporter, options);
+}
+
+flat_ast::module create_flat_ast(const lexer::token_buffer& tokens,
+                                 errors::reporter_interface& error_reporter,
+                                 const parse_options& options) {
+    return parse<flat_builder>(buffered_tokens(tokens), error_reporter, options);
+}
+
+flat_ast::module create_flat_ast(lexer::token_stream& tokens,
+                                 errors::reporter_interface& error_reporter,
+                                 const parse_options& options) {
+    return parse<flat_builder>(streamed_tokens(tokens), error_reporter, options);
 }
 
 } // namespace pierogi::parser
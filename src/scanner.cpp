@@ -0,0 +1,421 @@
+#include "scanner.hpp"
+#include "unicode.hpp"
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#define PIEROGI_HAS_SSE2 1
+#if defined(__GNUC__)
+#define PIEROGI_HAS_AVX2 1
+#endif
+#endif
+
+namespace pierogi::scanner {
+
+namespace {
+
+bool is_identifier_char(char c) {
+    return ('a' <= c && c <= 'z') ||
+           ('A' <= c && c <= 'Z') ||
+           ('0' <= c && c <= '9') ||
+           c == '_';
+}
+
+bool is_whitespace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+const char* skip_identifier_scalar(const char* begin, const char* end) {
+    while (begin != end && is_identifier_char(*begin)) begin++;
+    return begin;
+}
+
+const char* skip_whitespace_scalar(const char* begin, const char* end) {
+    while (begin != end && is_whitespace(*begin)) begin++;
+    return begin;
+}
+
+const char* find_line_end_scalar(const char* begin, const char* end) {
+    while (begin != end && *begin != '\n') begin++;
+    return begin;
+}
+
+const char* find_string_end_scalar(const char* begin, const char* end) {
+    while (begin != end && *begin != '"') begin++;
+    return begin;
+}
+
+const char* find_non_ascii_scalar(const char* begin, const char* end) {
+    while (begin != end && static_cast<unsigned char>(*begin) < 0x80) begin++;
+    return begin;
+}
+
+const char* validate_utf8_scalar(const char* begin, const char* end) {
+    while (begin != end) {
+        size_t length = unicode::decode(begin, end).length;
+        if (length == 0) return begin;
+        begin += length;
+    }
+    return begin;
+}
+
+// Finds the start of the first invalid sequence after a vectorized check
+// found one that involves bytes at or after `block`. The bytes before the
+// last character starting before `block` are known to be valid.
+const char* validate_utf8_from_block(const char* begin, const char* block, const char* end) {
+    const char* start = block;
+    while (start != begin && block - start < 4) {
+        start--;
+        if ((static_cast<unsigned char>(*start) & 0xC0) != 0x80) break;
+    }
+    return validate_utf8_scalar(start, end);
+}
+
+#if PIEROGI_HAS_SSE2
+
+// SSE2 only has signed byte comparisons, so a range check is done by shifting
+// the range's lower bound down to -128 and comparing against its new top
+__m128i in_range_sse2(__m128i chars, char low, char high) {
+    __m128i shifted = _mm_add_epi8(chars, _mm_set1_epi8(static_cast<char>(-128 - low)));
+    return _mm_cmplt_epi8(shifted, _mm_set1_epi8(static_cast<char>(-128 + (high - low) + 1)));
+}
+
+__m128i identifier_mask_sse2(__m128i chars) {
+    __m128i lowered = _mm_or_si128(chars, _mm_set1_epi8(0x20));
+    __m128i mask = in_range_sse2(lowered, 'a', 'z');
+    mask = _mm_or_si128(mask, in_range_sse2(chars, '0', '9'));
+    return _mm_or_si128(mask, _mm_cmpeq_epi8(chars, _mm_set1_epi8('_')));
+}
+
+unsigned bytes_of(__m128i mask) {
+    return static_cast<unsigned>(_mm_movemask_epi8(mask));
+}
+
+const char* skip_identifier_sse2(const char* begin, const char* end) {
+    for (; end - begin >= 16; begin += 16) {
+        __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+        unsigned stops = ~bytes_of(identifier_mask_sse2(chars)) & 0xFFFFu;
+        if (stops) return begin + __builtin_ctz(stops);
+    }
+    return skip_identifier_scalar(begin, end);
+}
+
+const char* skip_whitespace_sse2(const char* begin, const char* end) {
+    for (; end - begin >= 16; begin += 16) {
+        __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+        __m128i space = _mm_or_si128(_mm_cmpeq_epi8(chars, _mm_set1_epi8(' ')),
+                                     _mm_cmpeq_epi8(chars, _mm_set1_epi8('\t')));
+        space = _mm_or_si128(space, _mm_cmpeq_epi8(chars, _mm_set1_epi8('\r')));
+        space = _mm_or_si128(space, _mm_cmpeq_epi8(chars, _mm_set1_epi8('\n')));
+        unsigned stops = ~bytes_of(space) & 0xFFFFu;
+        if (stops) return begin + __builtin_ctz(stops);
+    }
+    return skip_whitespace_scalar(begin, end);
+}
+
+const char* find_line_end_sse2(const char* begin, const char* end) {
+    for (; end - begin >= 16; begin += 16) {
+        __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+        unsigned stops = bytes_of(_mm_cmpeq_epi8(chars, _mm_set1_epi8('\n')));
+        if (stops) return begin + __builtin_ctz(stops);
+    }
+    return find_line_end_scalar(begin, end);
+}
+
+const char* find_string_end_sse2(const char* begin, const char* end) {
+    for (; end - begin >= 16; begin += 16) {
+        __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+        unsigned stops = bytes_of(_mm_cmpeq_epi8(chars, _mm_set1_epi8('"')));
+        if (stops) return begin + __builtin_ctz(stops);
+    }
+    return find_string_end_scalar(begin, end);
+}
+
+const char* find_non_ascii_sse2(const char* begin, const char* end) {
+    for (; end - begin >= 16; begin += 16) {
+        unsigned stops = bytes_of(_mm_loadu_si128(reinterpret_cast<const __m128i*>(begin)));
+        if (stops) return begin + __builtin_ctz(stops);
+    }
+    return find_non_ascii_scalar(begin, end);
+}
+
+// Skips blocks of ASCII 16 bytes at a time and decodes everything else
+const char* validate_utf8_sse2(const char* begin, const char* end) {
+    while (end - begin >= 16) {
+        if (bytes_of(_mm_loadu_si128(reinterpret_cast<const __m128i*>(begin))) == 0) {
+            begin += 16;
+            continue;
+        }
+        const char* block_end = begin + 16;
+        while (begin < block_end) {
+            size_t length = unicode::decode(begin, end).length;
+            if (length == 0) return begin;
+            begin += length;
+        }
+    }
+    return validate_utf8_scalar(begin, end);
+}
+
+#endif // PIEROGI_HAS_SSE2
+
+#if PIEROGI_HAS_AVX2
+
+#define PIEROGI_TARGET_AVX2 __attribute__((target("avx2")))
+
+PIEROGI_TARGET_AVX2 __m256i in_range_avx2(__m256i chars, char low, char high) {
+    __m256i shifted = _mm256_add_epi8(chars, _mm256_set1_epi8(static_cast<char>(-128 - low)));
+    return _mm256_cmpgt_epi8(_mm256_set1_epi8(static_cast<char>(-128 + (high - low) + 1)), shifted);
+}
+
+PIEROGI_TARGET_AVX2 __m256i identifier_mask_avx2(__m256i chars) {
+    __m256i lowered = _mm256_or_si256(chars, _mm256_set1_epi8(0x20));
+    __m256i mask = in_range_avx2(lowered, 'a', 'z');
+    mask = _mm256_or_si256(mask, in_range_avx2(chars, '0', '9'));
+    return _mm256_or_si256(mask, _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('_')));
+}
+
+PIEROGI_TARGET_AVX2 unsigned bytes_of(__m256i mask) {
+    return static_cast<unsigned>(_mm256_movemask_epi8(mask));
+}
+
+PIEROGI_TARGET_AVX2 const char* skip_identifier_avx2(const char* begin, const char* end) {
+    for (; end - begin >= 32; begin += 32) {
+        __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+        unsigned stops = ~bytes_of(identifier_mask_avx2(chars));
+        if (stops) return begin + __builtin_ctz(stops);
+    }
+    return skip_identifier_sse2(begin, end);
+}
+
+PIEROGI_TARGET_AVX2 const char* skip_whitespace_avx2(const char* begin, const char* end) {
+    for (; end - begin >= 32; begin += 32) {
+        __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+        __m256i space = _mm256_or_si256(_mm256_cmpeq_epi8(chars, _mm256_set1_epi8(' ')),
+                                        _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('\t')));
+        space = _mm256_or_si256(space, _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('\r')));
+        space = _mm256_or_si256(space, _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('\n')));
+        unsigned stops = ~bytes_of(space);
+        if (stops) return begin + __builtin_ctz(stops);
+    }
+    return skip_whitespace_sse2(begin, end);
+}
+
+PIEROGI_TARGET_AVX2 const char* find_line_end_avx2(const char* begin, const char* end) {
+    for (; end - begin >= 32; begin += 32) {
+        __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+        unsigned stops = bytes_of(_mm256_cmpeq_epi8(chars, _mm256_set1_epi8('\n')));
+        if (stops) return begin + __builtin_ctz(stops);
+    }
+    return find_line_end_sse2(begin, end);
+}
+
+PIEROGI_TARGET_AVX2 const char* find_string_end_avx2(const char* begin, const char* end) {
+    for (; end - begin >= 32; begin += 32) {
+        __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+        unsigned stops = bytes_of(_mm256_cmpeq_epi8(chars, _mm256_set1_epi8('"')));
+        if (stops) return begin + __builtin_ctz(stops);
+    }
+    return find_string_end_sse2(begin, end);
+}
+
+PIEROGI_TARGET_AVX2 const char* find_non_ascii_avx2(const char* begin, const char* end) {
+    for (; end - begin >= 32; begin += 32) {
+        unsigned stops = bytes_of(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin)));
+        if (stops) return begin + __builtin_ctz(stops);
+    }
+    return find_non_ascii_sse2(begin, end);
+}
+
+// UTF-8 validation after Keiser and Lemire, "Validating UTF-8 In Less Than One
+// Instruction Per Byte". Every error shows up in the first two bytes of a
+// sequence, or as a missing or extra continuation byte, so three table
+// lookups per byte (on the high and low nibbles of the previous byte and the
+// high nibble of the current one) flag each possible error in its own bit.
+
+constexpr char TOO_SHORT = 1 << 0;
+constexpr char TOO_LONG = 1 << 1;
+constexpr char OVERLONG_3 = 1 << 2;
+constexpr char TOO_LARGE = 1 << 3;
+constexpr char SURROGATE = 1 << 4;
+constexpr char OVERLONG_2 = 1 << 5;
+constexpr char TOO_LARGE_1000 = 1 << 6;
+constexpr char OVERLONG_4 = 1 << 6;
+constexpr char TWO_CONTINUATIONS = static_cast<char>(1 << 7);
+constexpr char CARRY = TOO_SHORT | TOO_LONG | TWO_CONTINUATIONS;
+
+PIEROGI_TARGET_AVX2 __m256i lookup_avx2(__m256i nibbles, __m256i table) {
+    return _mm256_shuffle_epi8(table, nibbles);
+}
+
+PIEROGI_TARGET_AVX2 __m256i high_nibbles_avx2(__m256i bytes) {
+    return _mm256_and_si256(_mm256_srli_epi16(bytes, 4), _mm256_set1_epi8(0x0F));
+}
+
+// The bytes `N` places before each byte of `input`, taking the first few
+// from the end of `previous`
+template <int N>
+PIEROGI_TARGET_AVX2 __m256i previous_bytes_avx2(__m256i input, __m256i previous) {
+    return _mm256_alignr_epi8(input, _mm256_permute2x128_si256(previous, input, 0x21), 16 - N);
+}
+
+PIEROGI_TARGET_AVX2 __m256i utf8_errors_avx2(__m256i input, __m256i previous) {
+    __m256i previous1 = previous_bytes_avx2<1>(input, previous);
+    __m256i byte_1_high = lookup_avx2(high_nibbles_avx2(previous1), _mm256_setr_epi8(
+        TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+        TWO_CONTINUATIONS, TWO_CONTINUATIONS, TWO_CONTINUATIONS, TWO_CONTINUATIONS,
+        TOO_SHORT | OVERLONG_2,
+        TOO_SHORT,
+        TOO_SHORT | OVERLONG_3 | SURROGATE,
+        TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4,
+        TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+        TWO_CONTINUATIONS, TWO_CONTINUATIONS, TWO_CONTINUATIONS, TWO_CONTINUATIONS,
+        TOO_SHORT | OVERLONG_2,
+        TOO_SHORT,
+        TOO_SHORT | OVERLONG_3 | SURROGATE,
+        TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4));
+    __m256i byte_1_low = lookup_avx2(_mm256_and_si256(previous1, _mm256_set1_epi8(0x0F)), _mm256_setr_epi8(
+        CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+        CARRY | OVERLONG_2,
+        CARRY,
+        CARRY,
+        CARRY | TOO_LARGE,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+        CARRY | OVERLONG_2,
+        CARRY,
+        CARRY,
+        CARRY | TOO_LARGE,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000));
+    __m256i byte_2_high = lookup_avx2(high_nibbles_avx2(input), _mm256_setr_epi8(
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+        TOO_LONG | OVERLONG_2 | TWO_CONTINUATIONS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,
+        TOO_LONG | OVERLONG_2 | TWO_CONTINUATIONS | OVERLONG_3 | TOO_LARGE,
+        TOO_LONG | OVERLONG_2 | TWO_CONTINUATIONS | SURROGATE | TOO_LARGE,
+        TOO_LONG | OVERLONG_2 | TWO_CONTINUATIONS | SURROGATE | TOO_LARGE,
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+        TOO_LONG | OVERLONG_2 | TWO_CONTINUATIONS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,
+        TOO_LONG | OVERLONG_2 | TWO_CONTINUATIONS | OVERLONG_3 | TOO_LARGE,
+        TOO_LONG | OVERLONG_2 | TWO_CONTINUATIONS | SURROGATE | TOO_LARGE,
+        TOO_LONG | OVERLONG_2 | TWO_CONTINUATIONS | SURROGATE | TOO_LARGE,
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT));
+    __m256i special_cases = _mm256_and_si256(_mm256_and_si256(byte_1_high, byte_1_low), byte_2_high);
+
+    // The third and fourth bytes of three- and four-byte sequences must be
+    // continuations, which the lookups above treat as TWO_CONTINUATIONS errors
+    __m256i third_byte = _mm256_subs_epu8(previous_bytes_avx2<2>(input, previous), _mm256_set1_epi8(0xE0 - 0x80));
+    __m256i fourth_byte = _mm256_subs_epu8(previous_bytes_avx2<3>(input, previous), _mm256_set1_epi8(0xF0 - 0x80));
+    __m256i must_be_continuation = _mm256_and_si256(_mm256_or_si256(third_byte, fourth_byte), _mm256_set1_epi8(static_cast<char>(0x80)));
+    return _mm256_xor_si256(must_be_continuation, special_cases);
+}
+
+// Nonzero if the block ends partway through a sequence
+PIEROGI_TARGET_AVX2 __m256i utf8_incomplete_avx2(__m256i input) {
+    const __m256i last_lead_bytes = _mm256_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        static_cast<char>(0xF0 - 1), static_cast<char>(0xE0 - 1), static_cast<char>(0xC0 - 1));
+    return _mm256_subs_epu8(input, last_lead_bytes);
+}
+
+PIEROGI_TARGET_AVX2 const char* validate_utf8_avx2(const char* begin, const char* end) {
+    __m256i previous = _mm256_setzero_si256();
+    __m256i previous_incomplete = _mm256_setzero_si256();
+    const char* block = begin;
+    for (; end - block >= 32; block += 32) {
+        __m256i input = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block));
+        __m256i errors;
+        if (bytes_of(input) == 0) {
+            // Pure ASCII is only an error if the last block was cut short
+            errors = previous_incomplete;
+            previous_incomplete = _mm256_setzero_si256();
+        } else {
+            errors = utf8_errors_avx2(input, previous);
+            errors = _mm256_or_si256(errors, previous_incomplete);
+            previous_incomplete = utf8_incomplete_avx2(input);
+        }
+        if (!_mm256_testz_si256(errors, errors)) return validate_utf8_from_block(begin, block, end);
+        previous = input;
+    }
+    return validate_utf8_from_block(begin, block, end);
+}
+
+#undef PIEROGI_TARGET_AVX2
+
+#endif // PIEROGI_HAS_AVX2
+
+constexpr scanners scalar_scanners = {
+    skip_identifier_scalar, skip_whitespace_scalar,
+    find_line_end_scalar, find_string_end_scalar,
+    find_non_ascii_scalar, validate_utf8_scalar
+};
+
+#if PIEROGI_HAS_SSE2
+constexpr scanners sse2_scanners = {
+    skip_identifier_sse2, skip_whitespace_sse2,
+    find_line_end_sse2, find_string_end_sse2,
+    find_non_ascii_sse2, validate_utf8_sse2
+};
+#endif
+
+#if PIEROGI_HAS_AVX2
+constexpr scanners avx2_scanners = {
+    skip_identifier_avx2, skip_whitespace_avx2,
+    find_line_end_avx2, find_string_end_avx2,
+    find_non_ascii_avx2, validate_utf8_avx2
+};
+#endif
+
+} // namespace
+
+const scanners& best_scanners() {
+    static const scanners& best = scanners_for(supported_instruction_sets().back());
+    return best;
+}
+
+const scanners& scanners_for(instruction_set set) {
+    switch (set) {
+#if PIEROGI_HAS_AVX2
+    case instruction_set::AVX2:
+        return avx2_scanners;
+#endif
+#if PIEROGI_HAS_SSE2
+    case instruction_set::SSE2:
+        return sse2_scanners;
+#endif
+    default:
+        return scalar_scanners;
+    }
+}
+
+std::vector<instruction_set> supported_instruction_sets() {
+    std::vector<instruction_set> sets = {instruction_set::SCALAR};
+#if PIEROGI_HAS_SSE2
+    sets.push_back(instruction_set::SSE2);
+#endif
+#if PIEROGI_HAS_AVX2
+    if (__builtin_cpu_supports("avx2")) sets.push_back(instruction_set::AVX2);
+#endif
+    return sets;
+}
+
+} // namespace pierogi::scanner
@@ -0,0 +1,96 @@
+#include "source.hpp"
+#include "scanner.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <system_error>
+
+#if __has_include(<sys/mman.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define PIEROGI_HAS_MMAP 1
+#else
+#include <fstream>
+#include <sstream>
+#endif
+
+namespace pierogi::source {
+
+#if PIEROGI_HAS_MMAP
+
+namespace {
+
+[[noreturn]] void throw_file_error(const std::filesystem::path& path, const char* action) {
+    throw std::system_error(errno, std::generic_category(),
+                            std::string("Couldn't ") + action + " " + path.string());
+}
+
+} // namespace
+
+mapped_file::mapped_file(const std::filesystem::path& path) {
+    int descriptor = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (descriptor < 0) throw_file_error(path, "open");
+    struct stat status {};
+    if (::fstat(descriptor, &status) < 0) {
+        ::close(descriptor);
+        throw_file_error(path, "stat");
+    }
+    size = static_cast<size_t>(status.st_size);
+    // mmap() refuses zero-length mappings, and an empty file needs none
+    if (size != 0) {
+        void* mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        if (mapping == MAP_FAILED) {
+            ::close(descriptor);
+            throw_file_error(path, "map");
+        }
+        // The lexer reads front to back exactly once
+        ::madvise(mapping, size, MADV_SEQUENTIAL);
+        data = static_cast<const char*>(mapping);
+    }
+    // The mapping keeps the file's pages alive without the descriptor
+    ::close(descriptor);
+}
+
+mapped_file::~mapped_file() {
+    if (data != nullptr) ::munmap(const_cast<char*>(data), size);
+}
+
+#else
+
+mapped_file::mapped_file(const std::filesystem::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::system_error(std::make_error_code(std::errc::no_such_file_or_directory),
+                                "Couldn't open " + path.string());
+    }
+    std::ostringstream buffer;
+    buffer << file.rdbuf();
+    fallback_contents = buffer.str();
+    data = fallback_contents.data();
+    size = fallback_contents.size();
+}
+
+mapped_file::~mapped_file() = default;
+
+#endif // PIEROGI_HAS_MMAP
+
+line_index::line_index(std::string_view text) {
+    const scanner::scanners& scan = scanner::best_scanners();
+    line_starts.push_back(0);
+    const char* end = text.data() + text.size();
+    for (const char* newline = scan.find_line_end(text.data(), end); newline != end;
+         newline = scan.find_line_end(newline + 1, end)) {
+        line_starts.push_back(static_cast<uint32_t>(newline + 1 - text.data()));
+    }
+}
+
+location line_index::locate(size_t offset) const {
+    auto next_line = std::upper_bound(line_starts.begin(), line_starts.end(), offset);
+    auto line = static_cast<int>(next_line - line_starts.begin());
+    auto column = static_cast<int>(offset - *(next_line - 1)) + 1;
+    return {line, column};
+}
+
+} // namespace pierogi::source
@@ -0,0 +1,48 @@
+#include "symbols.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+
+namespace pierogi::symbols {
+
+symbol_id symbol_table::intern(std::string_view name) {
+    {
+        std::shared_lock lock(mutex);
+        auto found = ids.find(name);
+        if (found != ids.end()) return found->second;
+    }
+    std::unique_lock lock(mutex);
+    // Another thread may have interned the name while we waited for the lock
+    auto found = ids.find(name);
+    if (found != ids.end()) return found->second;
+    auto id = static_cast<symbol_id>(names.size());
+    std::string_view stored = store(name);
+    names.push_back(stored);
+    ids.emplace(stored, id);
+    return id;
+}
+
+std::string_view symbol_table::name(symbol_id id) const {
+    std::shared_lock lock(mutex);
+    return names[id];
+}
+
+size_t symbol_table::size() const {
+    std::shared_lock lock(mutex);
+    return names.size();
+}
+
+std::string_view symbol_table::store(std::string_view name) {
+    if (blocks.empty() || block_used + name.size() > block_size) {
+        // Names too long for a fresh block get one of their own
+        blocks.push_back(std::make_unique<char[]>(std::max(block_size, name.size())));
+        block_used = 0;
+    }
+    char* destination = blocks.back().get() + block_used;
+    std::memcpy(destination, name.data(), name.size());
+    block_used += name.size();
+    return {destination, name.size()};
+}
+
+} // namespace pierogi::symbols
@@ -0,0 +1,40 @@
+#include "types.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+namespace pierogi::types {
+
+namespace {
+
+template <typename TIterator>
+std::variant<std::forward_list<value>, std::vector<number>> pack(TIterator first, TIterator last) {
+    bool only_numbers = first != last && std::all_of(first, last, [](const value& v) {
+        return std::holds_alternative<number>(v);
+    });
+    if (!only_numbers) return std::forward_list<value>(first, last);
+    std::vector<number> numbers;
+    numbers.reserve(static_cast<size_t>(std::distance(first, last)));
+    for (; first != last; ++first) numbers.push_back(std::get<number>(*first));
+    return numbers;
+}
+
+} // namespace
+
+list::list(const std::vector<value>& contents) : contents(pack(contents.begin(), contents.end())) {}
+
+list::list(std::initializer_list<value>&& contents) : contents(pack(contents.begin(), contents.end())) {}
+
+size_t list::size() const {
+    if (packed()) return numbers().size();
+    const auto& values = std::get<std::forward_list<value>>(contents);
+    return static_cast<size_t>(std::distance(values.begin(), values.end()));
+}
+
+std::vector<value> list::elements() const {
+    if (packed()) return {numbers().begin(), numbers().end()};
+    const auto& values = std::get<std::forward_list<value>>(contents);
+    return {values.begin(), values.end()};
+}
+
+} // namespace pierogi::types
@@ -0,0 +1,88 @@
+#include "unicode.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+namespace pierogi::unicode {
+
+namespace {
+
+bool is_continuation(unsigned char byte) {
+    return (byte & 0xC0) == 0x80;
+}
+
+struct code_point_range {
+    char32_t first, last;
+};
+
+// Sorted and non-overlapping, so a code point's range is found by binary search
+constexpr code_point_range letters[] = {
+    {'A', 'Z'}, {'a', 'z'},
+    {0x00AA, 0x00AA}, {0x00B5, 0x00B5}, {0x00BA, 0x00BA},
+    {0x00C0, 0x00D6}, {0x00D8, 0x00F6}, {0x00F8, 0x02C1},
+    {0x02C6, 0x02D1}, {0x02E0, 0x02E4},
+    {0x0370, 0x0374}, {0x0376, 0x0377}, {0x037A, 0x037D}, {0x037F, 0x037F},
+    {0x0386, 0x0386}, {0x0388, 0x038A}, {0x038C, 0x038C}, {0x038E, 0x03A1},
+    {0x03A3, 0x03F5}, {0x03F7, 0x0481}, {0x048A, 0x052F},
+    {0x0531, 0x0556}, {0x0560, 0x0588},
+    {0x05D0, 0x05EA},
+    {0x0620, 0x064A}, {0x0671, 0x06D3},
+    {0x0904, 0x0939},
+    {0x0E01, 0x0E30},
+    {0x10A0, 0x10C5}, {0x10D0, 0x10FA},
+    {0x1100, 0x11FF},
+    {0x1E00, 0x1F15}, {0x1F18, 0x1F1D}, {0x1F20, 0x1F45}, {0x1F48, 0x1F4D},
+    {0x1F50, 0x1F57}, {0x1F59, 0x1F59}, {0x1F5B, 0x1F5B}, {0x1F5D, 0x1F5D},
+    {0x1F5F, 0x1F7D}, {0x1F80, 0x1FB4}, {0x1FB6, 0x1FBC}, {0x1FC2, 0x1FC4},
+    {0x1FC6, 0x1FCC}, {0x1FD0, 0x1FD3}, {0x1FD6, 0x1FDB}, {0x1FE0, 0x1FEC},
+    {0x1FF2, 0x1FF4}, {0x1FF6, 0x1FFC},
+    {0x3041, 0x3096}, {0x30A1, 0x30FA}, {0x3105, 0x312F},
+    {0x3400, 0x4DBF}, {0x4E00, 0x9FFF},
+    {0xAC00, 0xD7A3},
+    {0xF900, 0xFAFF},
+    {0xFF21, 0xFF3A}, {0xFF41, 0xFF5A},
+    {0x20000, 0x2A6DF}
+};
+
+} // namespace
+
+decoded_code_point decode(const char* begin, const char* end) {
+    auto lead = static_cast<unsigned char>(*begin);
+    if (lead < 0x80) return {lead, 1};
+    size_t length;
+    char32_t code_point, minimum;
+    if ((lead & 0xE0) == 0xC0) {
+        length = 2;
+        code_point = lead & 0x1F;
+        minimum = 0x80;
+    } else if ((lead & 0xF0) == 0xE0) {
+        length = 3;
+        code_point = lead & 0x0F;
+        minimum = 0x800;
+    } else if ((lead & 0xF8) == 0xF0) {
+        length = 4;
+        code_point = lead & 0x07;
+        minimum = 0x10000;
+    } else {
+        return {0, 0};
+    }
+    if (static_cast<size_t>(end - begin) < length) return {0, 0};
+    for (size_t i = 1; i < length; i++) {
+        auto byte = static_cast<unsigned char>(begin[i]);
+        if (!is_continuation(byte)) return {0, 0};
+        code_point = (code_point << 6) | (byte & 0x3F);
+    }
+    if (code_point < minimum || code_point > 0x10FFFF ||
+        (0xD800 <= code_point && code_point <= 0xDFFF)) {
+        return {0, 0};
+    }
+    return {code_point, length};
+}
+
+bool is_letter(char32_t code_point) {
+    auto range = std::upper_bound(std::begin(letters), std::end(letters), code_point,
+                                  [](char32_t c, const code_point_range& r) { return c < r.first; });
+    return range != std::begin(letters) && code_point <= std::prev(range)->last;
+}
+
+} // namespace pierogi::unicode
@@ -0,0 +1,83 @@
+#include "arena.hpp"
+
+#include "third-party/catch.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace pierogi;
+
+struct counted {
+    int& destroyed;
+    explicit counted(int& destroyed) : destroyed(destroyed) {}
+    ~counted() {
+        destroyed++;
+    }
+};
+
+TEST_CASE("Run destructors of arena objects when the arena goes") {
+    int destroyed = 0;
+    {
+        arena::bump_arena nodes;
+        for (int i = 0; i < 1000; i++) nodes.create<counted>(destroyed);
+        auto* name = nodes.create<std::string>(std::string(100, 'x'));
+        REQUIRE(*name == std::string(100, 'x'));
+        REQUIRE(destroyed == 0);
+    }
+    REQUIRE(destroyed == 1000);
+}
+
+TEST_CASE("Align arena objects and keep them in place as blocks fill") {
+    arena::bump_arena nodes;
+    std::vector<long double*> numbers;
+    for (int i = 0; i < 20000; i++) {
+        nodes.create<char>('a');
+        numbers.push_back(nodes.create<long double>(i));
+    }
+    for (int i = 0; i < 20000; i++) {
+        REQUIRE(reinterpret_cast<uintptr_t>(numbers[i]) % alignof(long double) == 0);
+        REQUIRE(*numbers[i] == i);
+    }
+    auto* big = static_cast<char*>(nodes.allocate(1 << 20, 1));
+    big[(1 << 20) - 1] = 'z';
+    REQUIRE(*numbers.front() == 0);
+    REQUIRE(nodes.bytes_used() >= (1 << 20) + 20000 * (1 + sizeof(long double)));
+}
+
+TEST_CASE("Copy runs of objects into the arena") {
+    arena::bump_arena nodes;
+    std::vector<int> values{1, 2, 3, 4};
+    auto copies = nodes.copy<int>(values.begin(), values.end());
+    values.clear();
+    REQUIRE(copies.size() == 4);
+    REQUIRE(copies.front() == 1);
+    REQUIRE(copies.back() == 4);
+    REQUIRE(std::vector<int>(copies.begin(), copies.end()) == std::vector<int>{1, 2, 3, 4});
+    REQUIRE(nodes.copy<int>(values.begin(), values.end()).empty());
+}
+
+TEST_CASE("Keep objects alive in an arena that's been adopted") {
+    int destroyed = 0;
+    {
+        arena::bump_arena nodes;
+        nodes.create<int>(1);
+        arena::span<int> values;
+        std::string* name;
+        {
+            arena::bump_arena worker;
+            values = worker.create_array<int>(3);
+            values[2] = 7;
+            worker.create<counted>(destroyed);
+            name = worker.create<std::string>(std::string(100, 'y'));
+            size_t used = worker.bytes_used();
+            nodes.adopt(std::move(worker));
+            REQUIRE(worker.bytes_used() == 0);
+            REQUIRE(nodes.bytes_used() == used + sizeof(int));
+        }
+        REQUIRE(std::vector<int>(values.begin(), values.end()) == std::vector<int>{0, 0, 7});
+        REQUIRE(*name == std::string(100, 'y'));
+        REQUIRE(destroyed == 0);
+    }
+    REQUIRE(destroyed == 1);
+}
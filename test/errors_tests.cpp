@@ -0,0 +1,68 @@
+#include "errors.hpp"
+
+#include "third-party/catch.hpp"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace pierogi;
+
+struct collecting_reporter : public errors::reporter_interface {
+    std::vector<std::string> near_lexemes;
+    std::vector<int> lines;
+
+    void report(errors::error_type type, std::string_view near_lexeme, int line, int column) override {
+        (void) type;
+        (void) column;
+        near_lexemes.emplace_back(near_lexeme);
+        lines.push_back(line);
+    }
+};
+
+TEST_CASE("Keep no more diagnostics than the limit") {
+    errors::diagnostics diagnostics(2);
+    REQUIRE(diagnostics.record(errors::error_type::UNRECOGNIZED_CHARACTER, 0, 1));
+    REQUIRE_FALSE(diagnostics.record(errors::error_type::UNRECOGNIZED_CHARACTER, 4, 1));
+    REQUIRE_FALSE(diagnostics.record(errors::error_type::UNRECOGNIZED_CHARACTER, 8, 1));
+    REQUIRE(diagnostics.full());
+    REQUIRE(diagnostics.size() == 2);
+    REQUIRE(diagnostics.begin()[1].offset == 4);
+    diagnostics.clear();
+    REQUIRE_FALSE(diagnostics.full());
+    REQUIRE(diagnostics.size() == 0);
+}
+
+TEST_CASE("Flush diagnostics in source order") {
+    const std::string source = "a $\nb ~\n\"c";
+    errors::diagnostics diagnostics(8);
+    diagnostics.record(errors::error_type::UNTERMINATED_STRING, 8, 2);
+    diagnostics.record(errors::error_type::UNRECOGNIZED_CHARACTER, 2, 1);
+    diagnostics.record(errors::error_type::UNRECOGNIZED_CHARACTER, 6, 1);
+    collecting_reporter reporter;
+    diagnostics.flush(source, reporter);
+    REQUIRE(reporter.near_lexemes == std::vector<std::string>{"$", "~", "\"c"});
+    REQUIRE(reporter.lines == std::vector<int>{1, 2, 3});
+    REQUIRE(diagnostics.size() == 0);
+}
+
+TEST_CASE("Record diagnostics from several threads at once") {
+    const size_t thread_count = 4, per_thread = 1000;
+    errors::diagnostics diagnostics(thread_count * per_thread / 2);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < thread_count; t++) {
+        threads.emplace_back([&, t] {
+            for (size_t i = 0; i < per_thread; i++) {
+                diagnostics.record(errors::error_type::INVALID_UTF8, t * per_thread + i, 1);
+            }
+        });
+    }
+    for (std::thread& thread : threads) thread.join();
+    REQUIRE(diagnostics.full());
+    REQUIRE(diagnostics.size() == thread_count * per_thread / 2);
+    std::vector<bool> seen(thread_count * per_thread);
+    for (const errors::diagnostic& d : diagnostics) {
+        REQUIRE_FALSE(seen[d.offset]);
+        seen[d.offset] = true;
+    }
+}
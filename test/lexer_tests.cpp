@@ -1,11 +1,15 @@
 #include "types.hpp"
 #include "errors.hpp"
 #include "lexer.hpp"
+#include "source.hpp"
 
 #include "third-party/catch.hpp"
 
 #include <algorithm>
+#include <filesystem>
+#include <fstream>
 #include <optional>
+#include <random>
 
 using namespace pierogi;
 using namespace pierogi::lexer;
@@ -13,7 +17,7 @@ using namespace pierogi::lexer;
 class dummy_reporter : public errors::reporter_interface {
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wunused-parameter"
-	void report(errors::error_type type, const std::string &message, int line) override {
+	void report(errors::error_type type, std::string_view message, int line, int column) override {
 		// Do nothing
 	}
 #pragma GCC diagnostic pop
@@ -49,7 +53,7 @@ void expect_token_sequence(const std::string& s, std::vector<token_type>&& expec
 
 void expect_final_line_number(const std::string& s, int expected) {
     auto tokens = tokenize(s, error_ignorer);
-    REQUIRE(tokens.back().line == expected);
+    REQUIRE(source::line_index(s).locate(tokens.back().offset).line == expected);
 }
 
 struct test_error_reporter : public errors::reporter_interface {
@@ -57,15 +61,14 @@ struct test_error_reporter : public errors::reporter_interface {
 	std::vector<errors::error_type> error_types;
     std::vector<std::string> near_lexemes;
     std::vector<int> lines;
+    std::vector<int> columns;
 
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wunused-parameter"
-	void report(errors::error_type type, const std::string &near_lexeme, int line) override {
+	void report(errors::error_type type, std::string_view near_lexeme, int line, int column) override {
 		error_types.push_back(type);
-        near_lexemes.push_back(near_lexeme);
+        near_lexemes.emplace_back(near_lexeme);
         lines.push_back(line);
+        columns.push_back(column);
 	}
-#pragma GCC diagnostic pop
 };
 
 void expect_error_type(const std::string& s, errors::error_type expected) {
@@ -89,19 +92,24 @@ void expect_error_on_line(const std::string& s, int expected) {
     REQUIRE(error_recorder.lines.back() == expected);
 }
 
+void expect_error_in_column(const std::string& s, int expected) {
+    auto error_recorder = test_error_reporter();
+    tokenize(s, error_recorder);
+    REQUIRE(error_recorder.columns.size() == 1);
+    REQUIRE(error_recorder.columns.back() == expected);
+}
+
 void expect_string_lexeme_contents(const std::string& s, const types::string& expected) {
     auto tokens = tokenize(s, error_ignorer);
     // The tokens list will always contain at least an EOF, so a front element definitely exists
-    const types::value& value = tokens.front().value;
-    REQUIRE(std::holds_alternative<types::string>(value));
-    REQUIRE(std::get<types::string>(value) == expected);
+    REQUIRE(tokens.front().type == token_type::STRING);
+    REQUIRE(string_contents(tokens.front()) == expected);
 }
 
 void expect_number_lexeme_contents(const std::string& s, types::number expected) {
     auto tokens = tokenize(s, error_ignorer);
-    const types::value& value = tokens.front().value;
-    REQUIRE(std::holds_alternative<types::number>(value));
-    REQUIRE(std::get<types::number>(value) == Approx(expected));
+    REQUIRE(tokens.front().type == token_type::NUMBER);
+    REQUIRE(decode_number(tokens.front()) == Approx(expected));
 }
 
 TEST_CASE("Read EOF from empty source") {
@@ -218,6 +226,43 @@ TEST_CASE("Use maximal munch to differentiate identifiers from keywords") {
     expect_single_token("falsey", token_type::IDENTIFIER);
 }
 
+TEST_CASE("Classify keywords and their look-alikes with either dispatch") {
+    // Keywords are hashed on their length and first and last letters, in a
+    // table of 16 slots, so these all land in a keyword's slot
+    const std::pair<std::string, token_type> keywords[] = {
+        {"and", token_type::AND}, {"or", token_type::OR}, {"not", token_type::NOT},
+        {"true", token_type::TRUE}, {"false", token_type::FALSE}, {"nil", token_type::NIL}
+    };
+    for (dispatch strategy : {dispatch::SWITCH, dispatch::TABLE}) {
+        for (const auto& [spelling, type] : keywords) {
+            auto tokens = tokenize(spelling, error_ignorer, strategy);
+            REQUIRE(tokens.type(0) == type);
+            std::string longer = spelling.front() + std::string(16, 'x') + spelling.substr(1);
+            std::string changed = spelling;
+            changed[changed.size() / 2] = changed[changed.size() / 2] == 'q' ? 'z' : 'q';
+            std::string capitalized = spelling;
+            capitalized.front() = static_cast<char>(capitalized.front() - 'a' + 'A');
+            for (const std::string& look_alike : {longer, changed, capitalized}) {
+                INFO(look_alike);
+                tokens = tokenize(look_alike, error_ignorer, strategy);
+                REQUIRE(tokens.size() == 2);
+                REQUIRE(tokens.type(0) == token_type::IDENTIFIER);
+            }
+        }
+    }
+}
+
+TEST_CASE("Recognize identifiers with non-ASCII letters") {
+    expect_single_token("gr\xC3\xB6\xC3\x9F" "e", token_type::IDENTIFIER);
+    expect_single_token("\xCF\x80", token_type::IDENTIFIER);
+    expect_single_token("\xE6\x97\xA5\xE6\x9C\xAC_2", token_type::IDENTIFIER);
+    expect_token_sequence("\xC3\xA9t\xC3\xA9 = caf\xC3\xA9", {
+        token_type::IDENTIFIER, token_type::EQUAL, token_type::IDENTIFIER
+    });
+    auto tokens = tokenize("caf\xC3\xA9 + x", error_ignorer);
+    REQUIRE(tokens.lexeme(0) == "caf\xC3\xA9");
+}
+
 TEST_CASE("Record line numbers") {
     expect_final_line_number("", 1);
     expect_final_line_number("one_line_source = 1", 1);
@@ -235,10 +280,21 @@ TEST_CASE("Report error for unrecognized characters") {
 
 TEST_CASE("Report error for unterminated string") {
     expect_error_type("\"string", errors::error_type::UNTERMINATED_STRING);
+    // Only the line the string starts on is reported, not the rest of the source
+    expect_error_near_lexeme("x = \"first\nsecond\nthird", "\"first");
+}
+
+TEST_CASE("Report error for invalid UTF-8") {
+    expect_error_type("x = \xFF", errors::error_type::INVALID_UTF8);
+    expect_error_type("\"caf\xC3\"", errors::error_type::INVALID_UTF8);
+    expect_error_near_lexeme("x = \xE6\x97 + 1", "\xE6\x97");
+    expect_error_in_column("ab\ncd \xC0\xAF", 4);
+    // Non-letters are valid UTF-8 but can't start a token
+    expect_error_type("total = \xE2\x88\x91 xs", errors::error_type::UNRECOGNIZED_CHARACTER);
+    expect_error_near_lexeme("total = \xE2\x88\x91 xs", "\xE2\x88\x91");
 }
 
 TEST_CASE("Record lexeme where error occurred") {
-    // TODO: Handle non-ASCII characters that cause unrecognized character errors
     expect_error_near_lexeme("| = 5", "|");
     expect_error_near_lexeme("\"unfinished", "\"unfinished");
 }
@@ -246,6 +302,13 @@ TEST_CASE("Record lexeme where error occurred") {
 TEST_CASE("Record number of line where error occurred") {
     expect_error_on_line("x = nil\ny = false\n$ = true", 3);
     expect_error_on_line("a = 1\n\"unfinished", 2);
+    expect_error_on_line("s = \"multi\nline\"\n\n  $", 4);
+}
+
+TEST_CASE("Record column where error occurred") {
+    expect_error_in_column("$ = true", 1);
+    expect_error_in_column("x = nil\ny = $", 5);
+    expect_error_in_column("a = 1\n\t\"unfinished", 2);
 }
 
 TEST_CASE("Extract contents of string tokens") {
@@ -257,6 +320,334 @@ TEST_CASE("Extract contents of string tokens") {
     // TODO: offer escape sequences in strings, such as \" and \n
 }
 
+TEST_CASE("Reference lexemes in the source instead of copying them") {
+    const std::string source("total = price * 3 .. \"units\"");
+    auto tokens = tokenize(source, error_ignorer);
+    REQUIRE(tokens.size() == 8);
+    for (const token& t : tokens) {
+        REQUIRE(t.lexeme.data() >= source.data());
+        REQUIRE(t.lexeme.data() + t.lexeme.size() <= source.data() + source.size());
+    }
+    REQUIRE(tokens[0].lexeme == "total");
+    REQUIRE(tokens[3].lexeme == "*");
+    REQUIRE(tokens[5].lexeme == "..");
+    REQUIRE(string_contents(tokens[6]).data() == source.data() + source.find("units"));
+    REQUIRE(tokens.back().lexeme.empty());
+}
+
+TEST_CASE("Produce identical tokens with switch and table dispatch") {
+    auto source = GENERATE(as<std::string>{},
+        "",
+        "\\ + - * / ^ < > = ( ) [ ] { } : . , == /= <= >= .. ...",
+        "a.b..c...d/=e//=f<==g>==h===",
+        "3.0 / 5 + (6 - 7) * 9^4 # trailing comment",
+        "valid = \\x { x <= 100 or x >= 0 and x /= nil }",
+        "\"multi\nline\" .. 12.5.6 ..7 \"unterminated",
+        "make_adder = \\n { \\x { x + n } }\nadd_five = make_adder(5)\r\n\tprint(add_five(7))",
+        "@ $ ~ ! ? ` % | & ' \xC3\xA9 nothing trueness");
+    auto switch_tokens = tokenize(source, error_ignorer, dispatch::SWITCH);
+    auto table_tokens = tokenize(source, error_ignorer, dispatch::TABLE);
+    REQUIRE(switch_tokens.size() == table_tokens.size());
+    for (size_t i = 0; i < switch_tokens.size(); i++) {
+        REQUIRE(switch_tokens[i].type == table_tokens[i].type);
+        REQUIRE(switch_tokens[i].lexeme.data() == table_tokens[i].lexeme.data());
+        REQUIRE(switch_tokens[i].lexeme.size() == table_tokens[i].lexeme.size());
+        REQUIRE(switch_tokens[i].offset == table_tokens[i].offset);
+    }
+}
+
+TEST_CASE("Store tokens as parallel arrays") {
+    const std::string source = "xs = [1.5, \"a\", 20]";
+    auto tokens = tokenize(source, error_ignorer);
+    REQUIRE(tokens.size() == 10);
+    REQUIRE(tokens.type(0) == token_type::IDENTIFIER);
+    REQUIRE(tokens.offset(0) == 0);
+    REQUIRE(tokens.length(0) == 2);
+    REQUIRE(tokens.type(4) == token_type::COMMA);
+    REQUIRE(tokens.offset(4) == source.find(','));
+    REQUIRE(tokens.lexeme(5) == "\"a\"");
+    REQUIRE(tokens.type(3) == token_type::NUMBER);
+    REQUIRE(tokens.lexeme(3) == "1.5");
+    REQUIRE(tokens.symbols()->name(tokens.symbol(0)) == "xs");
+    REQUIRE(tokens.offset(9) == source.size());
+}
+
+TEST_CASE("Intern identifiers") {
+    auto tokens = tokenize("total = price * count + price", error_ignorer);
+    const auto& symbols = *tokens.symbols();
+    REQUIRE(symbols.size() == 3);
+    REQUIRE(symbols.name(tokens.symbol(0)) == "total");
+    REQUIRE(symbols.name(tokens[2].symbol) == "price");
+    REQUIRE(tokens.symbol(2) == tokens.symbol(6));
+    REQUIRE(tokens.symbol(2) != tokens.symbol(4));
+}
+
+TEST_CASE("Stream the same tokens that tokenize returns") {
+    const std::string source = "make_adder = \\n { \\x { x + n } }\n# comment\nprint(\"done\", 12.5)";
+    auto tokens = tokenize(source, error_ignorer);
+    token_stream stream(source, error_ignorer);
+    for (size_t i = 0; i < tokens.size(); i++) {
+        for (size_t distance = 0; distance < token_stream::max_lookahead; distance++) {
+            size_t expected = std::min(i + distance, tokens.size() - 1);
+            REQUIRE(stream.peek(distance).type == tokens[expected].type);
+            REQUIRE(stream.peek(distance).lexeme.data() == tokens[expected].lexeme.data());
+        }
+        stream.advance();
+        REQUIRE(stream.previous().type == tokens[i].type);
+        REQUIRE(stream.previous().offset == tokens[i].offset);
+        if (tokens[i].type == token_type::IDENTIFIER) {
+            REQUIRE(stream.symbols()->name(stream.previous().symbol) == tokens.symbols()->name(tokens[i].symbol));
+        }
+    }
+    REQUIRE(stream.peek().type == token_type::EOF_);
+}
+
+TEST_CASE("Match brackets while lexing") {
+    auto tokens = tokenize("f([a, {b}], (c))", error_ignorer);
+    REQUIRE(tokens.partner(0) == token_buffer::no_partner);
+    REQUIRE(tokens.partner(1) == 13);
+    REQUIRE(tokens.partner(13) == 1);
+    REQUIRE(tokens.partner(2) == 8);
+    REQUIRE(tokens.partner(5) == 7);
+    REQUIRE(tokens.partner(7) == 5);
+    REQUIRE(tokens.partner(10) == 12);
+    REQUIRE(tokens.partner(3) == token_buffer::no_partner);
+
+    // A closer of the wrong kind is left unmatched without closing anything
+    tokens = tokenize("( ] ) ( [", error_ignorer);
+    REQUIRE(tokens.partner(0) == 2);
+    REQUIRE(tokens.partner(1) == token_buffer::no_partner);
+    REQUIRE(tokens.partner(3) == token_buffer::no_partner);
+    REQUIRE(tokens.partner(4) == token_buffer::no_partner);
+
+    tokens = tokenize(") (x)", error_ignorer);
+    REQUIRE(tokens.partner(0) == token_buffer::no_partner);
+    REQUIRE(tokens.partner(1) == 3);
+}
+
+TEST_CASE("Tokenize a file without copying it") {
+    const std::string source = "total = price * 3 .. \"units\"\n";
+    auto path = std::filesystem::temp_directory_path() / "pierogi_lexer_test.prgi";
+    std::ofstream(path, std::ios::binary) << source;
+    auto file = tokenize_file(path, error_ignorer);
+    std::filesystem::remove(path);
+    auto expected = tokenize(source, error_ignorer);
+    REQUIRE(file.tokens.size() == expected.size());
+    std::string_view mapped = file.source->contents();
+    for (size_t i = 0; i < expected.size(); i++) {
+        REQUIRE(file.tokens[i].type == expected[i].type);
+        REQUIRE(file.tokens[i].lexeme == expected[i].lexeme);
+        REQUIRE(file.tokens[i].lexeme.data() >= mapped.data());
+        REQUIRE(file.tokens[i].lexeme.data() + file.tokens[i].lexeme.size() <= mapped.data() + mapped.size());
+    }
+}
+
+// Random source where strings and comments often cross line boundaries and
+// hide each other's delimiters
+std::string make_tricky_source(unsigned seed, size_t size) {
+    static const char* const pieces[] = {
+        "x", " = ", "12.5", "\n", "\"", "# not \" a string\n", "\"# not a comment\"",
+        "[1, 2]", " .. ", "@", "\n\n", "and", "\"multi\nline\n\"", "==", "\t",
+        "\xC3\xA9t\xC3\xA9", "\xE2\x88\x91", "\xFF", "(", ")", "{", "]"
+    };
+    std::mt19937 generator(seed);
+    std::uniform_int_distribution<size_t> piece(0, std::size(pieces) - 1);
+    std::string source;
+    while (source.size() < size) source += pieces[piece(generator)];
+    return source;
+}
+
+TEST_CASE("Lex in parallel exactly as in serial") {
+    for (unsigned seed = 0; seed < 50; seed++) {
+        const std::string source = make_tricky_source(seed, 2000);
+        auto serial_errors = test_error_reporter();
+        auto parallel_errors = test_error_reporter();
+        auto serial = tokenize(source, serial_errors);
+        parallel_options options;
+        options.thread_count = 1 + seed % 8;
+        options.min_chunk_size = 16;
+        auto parallel = tokenize_parallel(source, parallel_errors, options);
+        REQUIRE(parallel.size() == serial.size());
+        for (size_t i = 0; i < serial.size(); i++) {
+            REQUIRE(parallel[i].type == serial[i].type);
+            REQUIRE(parallel[i].lexeme.data() == serial[i].lexeme.data());
+            REQUIRE(parallel[i].lexeme.size() == serial[i].lexeme.size());
+            REQUIRE(parallel[i].offset == serial[i].offset);
+            REQUIRE(parallel.partner(i) == serial.partner(i));
+            if (serial[i].type == token_type::IDENTIFIER) {
+                REQUIRE(parallel.symbols()->name(parallel[i].symbol) == serial.symbols()->name(serial[i].symbol));
+            }
+        }
+        REQUIRE(parallel_errors.error_types == serial_errors.error_types);
+        REQUIRE(parallel_errors.near_lexemes == serial_errors.near_lexemes);
+        REQUIRE(parallel_errors.lines == serial_errors.lines);
+        REQUIRE(parallel_errors.columns == serial_errors.columns);
+    }
+}
+
+TEST_CASE("Record errors as diagnostics and report them when flushed") {
+    const std::string source = "x = @\n\"caf\xC3\" $";
+    errors::diagnostics diagnostics(16);
+    auto tokens = tokenize(source, diagnostics);
+    REQUIRE(diagnostics.size() == 3);
+    REQUIRE(tokens.back().offset == source.size());
+
+    // Unlike a reporter, which hears about encoding errors first, flushing
+    // reports everything in source order
+    auto flushed = test_error_reporter();
+    diagnostics.flush(source, flushed);
+    REQUIRE(diagnostics.size() == 0);
+    REQUIRE(flushed.error_types == std::vector<errors::error_type>{
+        errors::error_type::UNRECOGNIZED_CHARACTER,
+        errors::error_type::INVALID_UTF8,
+        errors::error_type::UNRECOGNIZED_CHARACTER
+    });
+    REQUIRE(flushed.near_lexemes == std::vector<std::string>{"@", "\xC3", "$"});
+    REQUIRE(flushed.lines == std::vector<int>{1, 2, 2});
+    REQUIRE(flushed.columns == std::vector<int>{5, 5, 8});
+}
+
+TEST_CASE("Stop lexing once the diagnostics buffer is full") {
+    errors::diagnostics diagnostics(2);
+    std::string source = "a @ b $ c ~ d";
+    auto tokens = tokenize(source, diagnostics);
+    REQUIRE(diagnostics.full());
+    REQUIRE(tokens.size() == 3);
+    REQUIRE(tokens.lexeme(0) == "a");
+    REQUIRE(tokens.lexeme(1) == "b");
+    REQUIRE(tokens.type(2) == token_type::EOF_);
+
+    errors::diagnostics encoding_diagnostics(1);
+    tokens = tokenize("a \xFF b \xFF c", encoding_diagnostics);
+    REQUIRE(tokens.size() == 1);
+}
+
+TEST_CASE("Stream into a diagnostics buffer exactly as tokenize lexes into one") {
+    for (unsigned seed = 0; seed < 50; seed++) {
+        const std::string source = make_tricky_source(seed, 500);
+        const size_t limit = 1 + seed;
+        errors::diagnostics buffered_diagnostics(limit);
+        errors::diagnostics streamed_diagnostics(limit);
+        auto tokens = tokenize(source, buffered_diagnostics);
+        token_stream stream(source, streamed_diagnostics);
+        for (size_t i = 0; i < tokens.size(); i++) {
+            REQUIRE(stream.peek().type == tokens.type(i));
+            REQUIRE(stream.peek().offset == tokens.offset(i));
+            stream.advance();
+        }
+        auto buffered_errors = test_error_reporter();
+        auto streamed_errors = test_error_reporter();
+        buffered_diagnostics.flush(source, buffered_errors);
+        streamed_diagnostics.flush(source, streamed_errors);
+        REQUIRE(streamed_errors.error_types == buffered_errors.error_types);
+        REQUIRE(streamed_errors.near_lexemes == buffered_errors.near_lexemes);
+    }
+}
+
+TEST_CASE("Stop in parallel exactly where the serial lexer stops") {
+    for (unsigned seed = 0; seed < 50; seed++) {
+        const std::string source = make_tricky_source(seed, 2000);
+        const size_t limit = 1 + seed * 2;
+        errors::diagnostics serial_diagnostics(limit);
+        errors::diagnostics parallel_diagnostics(limit);
+        auto serial = tokenize(source, serial_diagnostics);
+        parallel_options options;
+        options.thread_count = 1 + seed % 8;
+        options.min_chunk_size = 16;
+        auto parallel = tokenize_parallel(source, parallel_diagnostics, options);
+        REQUIRE(parallel.size() == serial.size());
+        for (size_t i = 0; i < serial.size(); i++) {
+            REQUIRE(parallel.type(i) == serial.type(i));
+            REQUIRE(parallel.offset(i) == serial.offset(i));
+        }
+        auto serial_errors = test_error_reporter();
+        auto parallel_errors = test_error_reporter();
+        serial_diagnostics.flush(source, serial_errors);
+        parallel_diagnostics.flush(source, parallel_errors);
+        REQUIRE(parallel_errors.error_types == serial_errors.error_types);
+        REQUIRE(parallel_errors.near_lexemes == serial_errors.near_lexemes);
+    }
+}
+
+void expect_same_tokens(const token_buffer& actual, const token_buffer& expected) {
+    REQUIRE(actual.size() == expected.size());
+    for (size_t i = 0; i < expected.size(); i++) {
+        REQUIRE(actual.type(i) == expected.type(i));
+        REQUIRE(actual.offset(i) == expected.offset(i));
+        REQUIRE(actual.length(i) == expected.length(i));
+        REQUIRE(actual.partner(i) == expected.partner(i));
+        if (expected.type(i) == token_type::IDENTIFIER) {
+            REQUIRE(actual.symbols()->name(actual.symbol(i)) == expected.symbols()->name(expected.symbol(i)));
+        }
+    }
+}
+
+TEST_CASE("Relex an edited source") {
+    std::string source = "total = price * 3 .. \"units\"";
+    auto tokens = tokenize(source, error_ignorer);
+    // Removing " * " runs "price" into the number after it
+    source.replace(13, 3, "_2");
+    relex(tokens, source, {13, 3, 2}, error_ignorer);
+    expect_same_tokens(tokens, tokenize(source, error_ignorer));
+    REQUIRE(tokens.lexeme(2) == "price_23");
+    // Open a string that swallows the rest of the source
+    source.insert(0, "\"");
+    auto error_recorder = test_error_reporter();
+    relex(tokens, source, {0, 0, 1}, error_recorder);
+    expect_same_tokens(tokens, tokenize(source, error_ignorer));
+    REQUIRE(error_recorder.error_types.size() == 1);
+    // A digit after "12." turns it into one number
+    source = "12.x";
+    tokens = tokenize(source, error_ignorer);
+    source[3] = '5';
+    relex(tokens, source, {3, 1, 1}, error_ignorer);
+    expect_same_tokens(tokens, tokenize(source, error_ignorer));
+    REQUIRE(decode_number(tokens[0]) == Approx(12.5));
+}
+
+TEST_CASE("Relex random edits exactly as tokenize would") {
+    std::mt19937 generator(12345);
+    static const char* const insertions[] = {
+        "", "x", "\"", "#", "\n", "1", ".", "5", " ", "=", "/", "@", "and", "\"abc\"", "# c\n", "(", ")", "[", "]", "{", "}", "[x]",
+        "\xFF", "\xC3", "\xA9", "\xC3\xA9"
+    };
+    auto same_error = [](const errors::diagnostic& a, const errors::diagnostic& b) {
+        return a.type == b.type && a.offset == b.offset && a.length == b.length;
+    };
+    for (unsigned seed = 0; seed < 50; seed++) {
+        std::string source = make_tricky_source(seed, 300);
+        auto tokens = tokenize(source, error_ignorer);
+        for (int i = 0; i < 20; i++) {
+            size_t offset = std::uniform_int_distribution<size_t>(0, source.size())(generator);
+            size_t removed = std::min(source.size() - offset, std::uniform_int_distribution<size_t>(0, 4)(generator));
+            std::string inserted = insertions[std::uniform_int_distribution<size_t>(0, std::size(insertions) - 1)(generator)];
+            source.replace(offset, removed, inserted);
+            errors::diagnostics relexed_errors(1024);
+            errors::diagnostics fresh_errors(1024);
+            relex(tokens, source, {offset, removed, inserted.size()}, relexed_errors);
+            expect_same_tokens(tokens, tokenize(source, fresh_errors));
+
+            // Relexing reports each error in the stretch it lexed again once,
+            // just as tokenize does, and every error in the inserted bytes
+            for (auto error = relexed_errors.begin(); error != relexed_errors.end(); error++) {
+                REQUIRE(std::count_if(relexed_errors.begin(), relexed_errors.end(), [&](const errors::diagnostic& other) {
+                    return same_error(*error, other);
+                }) == 1);
+                REQUIRE(std::any_of(fresh_errors.begin(), fresh_errors.end(), [&](const errors::diagnostic& other) {
+                    return same_error(*error, other);
+                }));
+            }
+            for (const errors::diagnostic& error : fresh_errors) {
+                if (error.offset >= offset && error.offset < offset + inserted.size()) {
+                    REQUIRE(std::any_of(relexed_errors.begin(), relexed_errors.end(), [&](const errors::diagnostic& other) {
+                        return same_error(error, other);
+                    }));
+                }
+            }
+        }
+    }
+}
+
 TEST_CASE("Extract contents of number tokens") {
     expect_number_lexeme_contents("123", 123);
     expect_number_lexeme_contents("456.", 456);
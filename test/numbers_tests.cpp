@@ -0,0 +1,51 @@
+#include "numbers.hpp"
+
+#include "third-party/catch.hpp"
+
+#include <random>
+#include <string>
+
+using namespace pierogi;
+
+void expect_same_as_stold(const std::string& literal) {
+    INFO(literal);
+    REQUIRE(numbers::parse_literal(literal) == std::stold(literal));
+}
+
+TEST_CASE("Parse integer literals") {
+    expect_same_as_stold("0");
+    expect_same_as_stold("7");
+    expect_same_as_stold("000123");
+    expect_same_as_stold("9007199254740993");
+    expect_same_as_stold("18446744073709551615");
+    expect_same_as_stold("9999999999999999999");
+    expect_same_as_stold("123456789012345678901234567890");
+}
+
+TEST_CASE("Parse decimal literals") {
+    expect_same_as_stold("0.1");
+    expect_same_as_stold("0.0125");
+    expect_same_as_stold("00001.23");
+    expect_same_as_stold("123.456");
+    expect_same_as_stold("3.141592653589793238");
+    expect_same_as_stold("0.000000000000000000000000001");
+    expect_same_as_stold("0.0000000000000000000000000001");
+    expect_same_as_stold("1.00000000000000000000000000000");
+    expect_same_as_stold("123456789.123456789123456789");
+    expect_same_as_stold("2.2250738585072011");
+}
+
+TEST_CASE("Parse random literals exactly") {
+    std::mt19937_64 generator(1234);
+    std::uniform_int_distribution<int> length(1, 24);
+    std::uniform_int_distribution<int> digit(0, 9);
+    for (int i = 0; i < 10000; i++) {
+        std::string literal;
+        for (int n = length(generator); n > 0; n--) literal += static_cast<char>('0' + digit(generator));
+        if (i % 4 != 0) {
+            literal += '.';
+            for (int n = length(generator); n > 0; n--) literal += static_cast<char>('0' + digit(generator));
+        }
+        expect_same_as_stold(literal);
+    }
+}
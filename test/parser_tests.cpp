@@ -1,16 +1,22 @@
 #include "parser.hpp"
 #include "lexer.hpp"
 #include "generated/ast.hpp"
+#include "generated/flat_ast.hpp"
 
 #include "third-party/catch.hpp"
 
+#include <algorithm>
+#include <string>
+#include <type_traits>
+#include <vector>
+
 using namespace pierogi;
 using namespace pierogi::parser;
 
 class dummy_reporter : public errors::reporter_interface {
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wunused-parameter"
-    void report(errors::error_type type, const std::string &message, int line) override {
+    void report(errors::error_type type, std::string_view message, int line, int column) override {
         // Do nothing
     }
 #pragma GCC diagnostic pop
@@ -18,80 +24,563 @@ class dummy_reporter : public errors::reporter_interface {
 
 static auto error_ignorer = dummy_reporter();
 
-template <typename TExpressionPointer>
+// Every test runs against both the pointer-based and the flat AST, through
+// these helpers, which use the pointer-based node types as tags for both
+
+template <typename TModule, typename TTokens>
+TModule parse(TTokens& tokens,
+              errors::reporter_interface& error_reporter = error_ignorer,
+              const parse_options& options = {}) {
+    if constexpr (std::is_same_v<TModule, ast::module>) {
+        return create_ast(tokens, error_reporter, options);
+    } else {
+        return create_flat_ast(tokens, error_reporter, options);
+    }
+}
+
+template <typename TNode>
+bool holds_node(const ast::module&, const ast::expression& expression) {
+    return std::holds_alternative<const TNode*>(expression);
+}
+
+template <typename TNode>
+const TNode& node_as(const ast::module&, const ast::expression& expression) {
+    return *std::get<const TNode*>(expression);
+}
+
+template <typename TNode>
+bool holds_node(const flat_ast::module& module, flat_ast::node_index index) {
+    return module.is<TNode>(index);
+}
+
+template <typename TNode>
+flat_ast::view<TNode> node_as(const flat_ast::module& module, flat_ast::node_index index) {
+    return module.get<TNode>(index);
+}
+
+template <typename TModule, typename TNode>
 void expect_ast_node_type(const std::string& s) {
     auto tokens = lexer::tokenize(s, error_ignorer);
-    auto parse_tree = create_ast(tokens, error_ignorer);
-    REQUIRE(parse_tree.size() == 1);
-    REQUIRE(std::holds_alternative<TExpressionPointer>(parse_tree.front()));
+    auto parse_tree = parse<TModule>(tokens);
+    REQUIRE(parse_tree.expressions.size() == 1);
+    REQUIRE(holds_node<TNode>(parse_tree, parse_tree.expressions.front()));
 }
 
-template <typename TExpressionPointer, typename TValue>
+template <typename TModule, typename TNode, typename TValue>
 void expect_ast_node_with_value(const std::string& s, TValue expected) {
     auto tokens = lexer::tokenize(s, error_ignorer);
-    auto parse_tree = create_ast(tokens, error_ignorer);
-    REQUIRE(parse_tree.size() == 1);
-    REQUIRE(std::holds_alternative<TExpressionPointer>(parse_tree.front()));
-    TExpressionPointer expression = std::get<TExpressionPointer>(parse_tree.front());
-    REQUIRE(expression->value == expected);
+    auto parse_tree = parse<TModule>(tokens);
+    REQUIRE(parse_tree.expressions.size() == 1);
+    REQUIRE(holds_node<TNode>(parse_tree, parse_tree.expressions.front()));
+    REQUIRE(node_as<TNode>(parse_tree, parse_tree.expressions.front()).value == expected);
 }
 
-template <typename TExpressionPointer, typename TExpectedExpressionPointer>
+template <typename TModule, typename TNode, typename TExpectedNode>
 void expect_ast_node_with_inside_type(const std::string& s) {
     auto tokens = lexer::tokenize(s, error_ignorer);
-    auto parse_tree = create_ast(tokens, error_ignorer);
-    REQUIRE(parse_tree.size() == 1);
-    REQUIRE(std::holds_alternative<TExpressionPointer>(parse_tree.front()));
-    TExpressionPointer expression = std::get<TExpressionPointer>(parse_tree.front());
-    REQUIRE(std::holds_alternative<TExpectedExpressionPointer>(expression->inside));
+    auto parse_tree = parse<TModule>(tokens);
+    REQUIRE(parse_tree.expressions.size() == 1);
+    REQUIRE(holds_node<TNode>(parse_tree, parse_tree.expressions.front()));
+    auto inside = node_as<TNode>(parse_tree, parse_tree.expressions.front()).inside;
+    REQUIRE(holds_node<TExpectedNode>(parse_tree, inside));
 }
 
-TEST_CASE("Parse valueless literals") {
-    expect_ast_node_type<ast::nil_pointer>("nil");
-    expect_ast_node_type<ast::true_boolean_pointer>("true");
-    expect_ast_node_type<ast::false_boolean_pointer>("false");
+TEMPLATE_TEST_CASE("Parse valueless literals", "", ast::module, flat_ast::module) {
+    expect_ast_node_type<TestType, ast::nil>("nil");
+    expect_ast_node_type<TestType, ast::true_boolean>("true");
+    expect_ast_node_type<TestType, ast::false_boolean>("false");
 }
 
-TEST_CASE("Parse valued literals") {
-    expect_ast_node_with_value<ast::number_pointer, types::number>("5", 5);
-    expect_ast_node_with_value<ast::string_pointer, types::string>("\"string\"", "string");
+TEMPLATE_TEST_CASE("Parse valued literals", "", ast::module, flat_ast::module) {
+    expect_ast_node_with_value<TestType, ast::number, types::number>("5", 5);
+    expect_ast_node_with_value<TestType, ast::string, types::string>("\"string\"", "string");
 }
 
-TEST_CASE("Parse wrapper expressions") {
-    expect_ast_node_with_inside_type<ast::group_pointer, ast::number_pointer>("(5)");
-    expect_ast_node_with_inside_type<ast::arithmetic_negation_pointer, ast::number_pointer>("-5");
-    expect_ast_node_with_inside_type<ast::logical_negation_pointer, ast::true_boolean_pointer>("not true");
+TEMPLATE_TEST_CASE("Parse wrapper expressions", "", ast::module, flat_ast::module) {
+    expect_ast_node_with_inside_type<TestType, ast::group, ast::number>("(5)");
+    expect_ast_node_with_inside_type<TestType, ast::arithmetic_negation, ast::number>("-5");
+    expect_ast_node_with_inside_type<TestType, ast::logical_negation, ast::true_boolean>("not true");
 }
 
-TEST_CASE("Parse binary expressions") {
-    expect_ast_node_type<ast::addition_pointer>("5 + 6");
-    expect_ast_node_type<ast::subtraction_pointer>("6 - 5");
-    expect_ast_node_type<ast::multiplication_pointer>("5 * 6");
-    expect_ast_node_type<ast::division_pointer>("6 / 5");
-    expect_ast_node_type<ast::less_than_pointer>("5 < 6");
-    expect_ast_node_type<ast::greater_than_pointer>("6 > 5");
-    expect_ast_node_type<ast::less_equal_pointer>("5 <= 6");
-    expect_ast_node_type<ast::greater_equal_pointer>("6 >= 5");
-    expect_ast_node_type<ast::equals_pointer>("5 == 5");
-    expect_ast_node_type<ast::not_equals_pointer>("5 /= 6");
+TEMPLATE_TEST_CASE("Parse binary expressions", "", ast::module, flat_ast::module) {
+    expect_ast_node_type<TestType, ast::addition>("5 + 6");
+    expect_ast_node_type<TestType, ast::subtraction>("6 - 5");
+    expect_ast_node_type<TestType, ast::multiplication>("5 * 6");
+    expect_ast_node_type<TestType, ast::division>("6 / 5");
+    expect_ast_node_type<TestType, ast::less_than>("5 < 6");
+    expect_ast_node_type<TestType, ast::greater_than>("6 > 5");
+    expect_ast_node_type<TestType, ast::less_equal>("5 <= 6");
+    expect_ast_node_type<TestType, ast::greater_equal>("6 >= 5");
+    expect_ast_node_type<TestType, ast::equals>("5 == 5");
+    expect_ast_node_type<TestType, ast::not_equals>("5 /= 6");
 }
 
-TEST_CASE("Parse list literals") {
-    auto tokens = lexer::tokenize("[1, 2, 3]", error_ignorer);
-    auto parse_tree = parser::create_ast(tokens, error_ignorer);
-    REQUIRE(parse_tree.size() == 1);
-    REQUIRE(std::holds_alternative<ast::list_pointer>(parse_tree.front()));
-    auto contents = std::get<ast::list_pointer>(parse_tree.front())->contents;
+TEMPLATE_TEST_CASE("Parse list literals", "", ast::module, flat_ast::module) {
+    auto tokens = lexer::tokenize("[1, 2 + 3, 4]", error_ignorer);
+    auto parse_tree = parse<TestType>(tokens);
+    REQUIRE(parse_tree.expressions.size() == 1);
+    REQUIRE(holds_node<ast::list>(parse_tree, parse_tree.expressions.front()));
+    auto contents = node_as<ast::list>(parse_tree, parse_tree.expressions.front()).contents;
     REQUIRE(contents.size() == 3);
-    REQUIRE(std::all_of(contents.begin(), contents.end(), [](const ast::expression& expression) {
-        return std::holds_alternative<ast::number_pointer>(expression);
-    }));
+    REQUIRE(holds_node<ast::number>(parse_tree, contents[0]));
+    REQUIRE(holds_node<ast::addition>(parse_tree, contents[1]));
+    REQUIRE(holds_node<ast::number>(parse_tree, contents[2]));
+}
+
+template <typename TModule, typename TTokens>
+void expect_literal_lists_folded(TTokens& tokens) {
+    auto parse_tree = parse<TModule>(tokens);
+    REQUIRE(parse_tree.expressions.size() == 6);
+    const types::list& numbers = node_as<ast::constant_list>(parse_tree, parse_tree.expressions[0]).value;
+    REQUIRE(numbers.packed());
+    REQUIRE(numbers.numbers() == std::vector<types::number>{1, 2.5, 3});
+    const types::list& mixed = node_as<ast::constant_list>(parse_tree, parse_tree.expressions[1]).value;
+    REQUIRE_FALSE(mixed.packed());
+    auto elements = mixed.elements();
+    REQUIRE(elements.size() == 4);
+    REQUIRE(std::get<types::string>(elements[0]) == "a");
+    REQUIRE(std::get<types::boolean>(elements[1]));
+    REQUIRE(std::holds_alternative<types::nil_type>(elements[2]));
+    REQUIRE(std::get<types::number>(elements[3]) == -4);
+    // Only whole lists of literals are folded
+    auto outer = node_as<ast::list>(parse_tree, parse_tree.expressions[2]).contents;
+    REQUIRE(outer.size() == 2);
+    REQUIRE(node_as<ast::constant_list>(parse_tree, outer[0]).value.size() == 1);
+    REQUIRE(holds_node<ast::identifier>(parse_tree, outer[1]));
+    // Negative numbers are written negated, but they're still literals
+    const types::list& negatives = node_as<ast::constant_list>(parse_tree, parse_tree.expressions[3]).value;
+    REQUIRE(negatives.packed());
+    REQUIRE(negatives.numbers() == std::vector<types::number>{-1, 2, -0.5});
+    REQUIRE(holds_node<ast::list>(parse_tree, parse_tree.expressions[4]));
+    REQUIRE(holds_node<ast::list>(parse_tree, parse_tree.expressions[5]));
+}
+
+TEMPLATE_TEST_CASE("Fold lists of literals into constants", "", ast::module, flat_ast::module) {
+    const std::string source = "[1, 2.5, 3] [\"a\", true, nil, -4] [[5], x] [-1, 2, -0.5] [-x] []";
+    auto tokens = lexer::tokenize(source, error_ignorer);
+    expect_literal_lists_folded<TestType>(tokens);
+    lexer::token_stream stream(source, error_ignorer);
+    expect_literal_lists_folded<TestType>(stream);
+
+    parse_options options;
+    options.fold_literal_lists = false;
+    auto unfolded = parse<TestType>(tokens, error_ignorer, options);
+    REQUIRE(node_as<ast::list>(unfolded, unfolded.expressions[0]).contents.size() == 3);
+}
+
+TEMPLATE_TEST_CASE("Parse identifiers as interned symbols", "", ast::module, flat_ast::module) {
+    auto tokens = lexer::tokenize("price * count - price", error_ignorer);
+    auto parse_tree = parse<TestType>(tokens);
+    REQUIRE(parse_tree.expressions.size() == 1);
+    auto subtraction = node_as<ast::subtraction>(parse_tree, parse_tree.expressions.front());
+    auto multiplication = node_as<ast::multiplication>(parse_tree, subtraction.lhs);
+    auto first_price = node_as<ast::identifier>(parse_tree, multiplication.lhs).name;
+    auto count = node_as<ast::identifier>(parse_tree, multiplication.rhs).name;
+    auto second_price = node_as<ast::identifier>(parse_tree, subtraction.rhs).name;
+    REQUIRE(first_price == second_price);
+    REQUIRE(first_price != count);
+    REQUIRE(parse_tree.symbol_names->name(count) == "count");
+}
+
+TEMPLATE_TEST_CASE("Parse from a token stream", "", ast::module, flat_ast::module) {
+    const std::string source = "[1, \"two\", x] (5) 6 / 5 not true";
+    lexer::token_stream stream(source, error_ignorer);
+    auto parse_tree = parse<TestType>(stream);
+    REQUIRE(parse_tree.expressions.size() == 4);
+    REQUIRE(holds_node<ast::list>(parse_tree, parse_tree.expressions[0]));
+    REQUIRE(node_as<ast::list>(parse_tree, parse_tree.expressions[0]).contents.size() == 3);
+    REQUIRE(holds_node<ast::group>(parse_tree, parse_tree.expressions[1]));
+    REQUIRE(holds_node<ast::division>(parse_tree, parse_tree.expressions[2]));
+    REQUIRE(holds_node<ast::logical_negation>(parse_tree, parse_tree.expressions[3]));
+}
+
+TEMPLATE_TEST_CASE("Keep the tree alive after the tokens are gone", "", ast::module, flat_ast::module) {
+    TestType module;
+    {
+        auto tokens = lexer::tokenize("[[1, \"two\"], [], [x, [3]]]", error_ignorer);
+        module = parse<TestType>(tokens);
+    }
+    REQUIRE(module.expressions.size() == 1);
+    auto outer = node_as<ast::list>(module, module.expressions.front()).contents;
+    REQUIRE(outer.size() == 3);
+    auto first = node_as<ast::constant_list>(module, outer[0]).value.elements();
+    REQUIRE(std::get<types::number>(first[0]) == 1);
+    REQUIRE(std::get<types::string>(first[1]) == "two");
+    REQUIRE(node_as<ast::list>(module, outer[1]).contents.empty());
+    auto third = node_as<ast::list>(module, outer[2]).contents;
+    REQUIRE(module.symbol_names->name(node_as<ast::identifier>(module, third[0]).name) == "x");
+    REQUIRE(node_as<ast::constant_list>(module, third[1]).value.size() == 1);
+}
+
+template <typename TModule, typename TExpression>
+std::string to_sexpression(const TModule& module, const TExpression& expression);
+
+template <typename TNode, typename TModule, typename TExpression>
+bool print_binary(const TModule& module, const TExpression& expression, const std::string& symbol,
+                  std::string& printed) {
+    if (!holds_node<TNode>(module, expression)) return false;
+    auto node = node_as<TNode>(module, expression);
+    printed = "(" + symbol + " " + to_sexpression(module, node.lhs) + " " + to_sexpression(module, node.rhs) + ")";
+    return true;
+}
+
+// Prints the parts of the tree the precedence tests care about
+template <typename TModule, typename TExpression>
+std::string to_sexpression(const TModule& module, const TExpression& expression) {
+    std::string printed;
+    if (print_binary<ast::disjunction>(module, expression, "or", printed) ||
+        print_binary<ast::conjunction>(module, expression, "and", printed) ||
+        print_binary<ast::equals>(module, expression, "==", printed) ||
+        print_binary<ast::construction>(module, expression, ":", printed) ||
+        print_binary<ast::concatenation>(module, expression, "..", printed) ||
+        print_binary<ast::less_than>(module, expression, "<", printed) ||
+        print_binary<ast::addition>(module, expression, "+", printed) ||
+        print_binary<ast::subtraction>(module, expression, "-", printed) ||
+        print_binary<ast::multiplication>(module, expression, "*", printed) ||
+        print_binary<ast::division>(module, expression, "/", printed)) {
+        return printed;
+    }
+    if (holds_node<ast::exponentiation>(module, expression)) {
+        auto node = node_as<ast::exponentiation>(module, expression);
+        return "(^ " + to_sexpression(module, node.base) + " " + to_sexpression(module, node.power) + ")";
+    }
+    if (holds_node<ast::arithmetic_negation>(module, expression)) {
+        return "(- " + to_sexpression(module, node_as<ast::arithmetic_negation>(module, expression).inside) + ")";
+    }
+    if (holds_node<ast::logical_negation>(module, expression)) {
+        return "(not " + to_sexpression(module, node_as<ast::logical_negation>(module, expression).inside) + ")";
+    }
+    if (holds_node<ast::group>(module, expression)) {
+        return "(group " + to_sexpression(module, node_as<ast::group>(module, expression).inside) + ")";
+    }
+    if (holds_node<ast::number>(module, expression)) {
+        return std::to_string(static_cast<long long>(node_as<ast::number>(module, expression).value));
+    }
+    if (holds_node<ast::identifier>(module, expression)) {
+        return std::string(module.symbol_names->name(node_as<ast::identifier>(module, expression).name));
+    }
+    if (holds_node<ast::list>(module, expression)) {
+        std::string elements;
+        for (auto element : node_as<ast::list>(module, expression).contents) {
+            if (!elements.empty()) elements += " ";
+            elements += to_sexpression(module, element);
+        }
+        return "[" + elements + "]";
+    }
+    if (holds_node<ast::constant_list>(module, expression)) {
+        return "(constant " + std::to_string(node_as<ast::constant_list>(module, expression).value.size()) + ")";
+    }
+    if (holds_node<ast::string>(module, expression)) {
+        return "\"" + node_as<ast::string>(module, expression).value + "\"";
+    }
+    if (holds_node<ast::true_boolean>(module, expression)) return "true";
+    if (holds_node<ast::false_boolean>(module, expression)) return "false";
+    if (holds_node<ast::nil>(module, expression)) return "nil";
+    return "?";
+}
+
+template <typename TModule>
+void expect_parsed_as(const std::string& s, const std::string& expected, const parse_options& options = {}) {
+    auto tokens = lexer::tokenize(s, error_ignorer);
+    auto parse_tree = parse<TModule>(tokens, error_ignorer, options);
+    REQUIRE(parse_tree.expressions.size() == 1);
+    REQUIRE(to_sexpression(parse_tree, parse_tree.expressions.front()) == expected);
+}
+
+TEMPLATE_TEST_CASE("Parse binary operators by precedence", "", ast::module, flat_ast::module) {
+    expect_parsed_as<TestType>("1 + 2 * 3", "(+ 1 (* 2 3))");
+    expect_parsed_as<TestType>("1 * 2 + 3", "(+ (* 1 2) 3)");
+    expect_parsed_as<TestType>("(1 + 2) * 3", "(* (group (+ 1 2)) 3)");
+    expect_parsed_as<TestType>("a or b and c == d", "(or a (and b (== c d)))");
+    expect_parsed_as<TestType>("a and b or c", "(or (and a b) c)");
+    expect_parsed_as<TestType>("xs .. ys == zs", "(== (.. xs ys) zs)");
+    expect_parsed_as<TestType>("a < b .. c", "(.. (< a b) c)");
+    expect_parsed_as<TestType>("a < b + c", "(< a (+ b c))");
+    expect_parsed_as<TestType>("a * b ^ c", "(* a (^ b c))");
+}
+
+TEMPLATE_TEST_CASE("Parse binary operators by associativity", "", ast::module, flat_ast::module) {
+    expect_parsed_as<TestType>("1 - 2 - 3", "(- (- 1 2) 3)");
+    expect_parsed_as<TestType>("1 / 2 * 3", "(* (/ 1 2) 3)");
+    expect_parsed_as<TestType>("a or b or c", "(or (or a b) c)");
+    expect_parsed_as<TestType>("2 ^ 3 ^ 2", "(^ 2 (^ 3 2))");
+    expect_parsed_as<TestType>("1 : 2 : xs", "(: 1 (: 2 xs))");
+    expect_parsed_as<TestType>("xs .. ys .. zs", "(.. xs (.. ys zs))");
+}
+
+TEMPLATE_TEST_CASE("Parse prefix operators between factors and exponents", "", ast::module, flat_ast::module) {
+    expect_parsed_as<TestType>("-2 ^ 2", "(- (^ 2 2))");
+    expect_parsed_as<TestType>("-a * b", "(* (- a) b)");
+    expect_parsed_as<TestType>("- -a", "(- (- a))");
+    expect_parsed_as<TestType>("not a == b", "(== (not a) b)");
+    expect_parsed_as<TestType>("2 ^ -1", "(^ 2 (- 1))");
+}
+
+TEMPLATE_TEST_CASE("Fold constant expressions when asked to", "", ast::module, flat_ast::module) {
+    parse_options options;
+    options.fold_constants = true;
+    expect_parsed_as<TestType>("1 + 2 * 3", "7", options);
+    expect_parsed_as<TestType>("(1 + 2) * -3", "-9", options);
+    expect_parsed_as<TestType>("-(2 ^ 3)", "-8", options);
+    expect_parsed_as<TestType>("not (1 < 2) or 3 >= 3", "true", options);
+    expect_parsed_as<TestType>("\"a\" == \"a\" and nil /= nil", "false", options);
+    expect_parsed_as<TestType>("(\"s\")", "\"s\"", options);
+    // Only the constant parts of an expression are folded
+    expect_parsed_as<TestType>("x * (2 + 3)", "(* x 5)", options);
+    expect_parsed_as<TestType>("(x)", "(group x)", options);
+    // Left for run time, where they might behave differently
+    expect_parsed_as<TestType>("1 / (1 - 1)", "(/ 1 0)", options);
+    expect_parsed_as<TestType>("1 == true", "(== 1 true)", options);
+    expect_parsed_as<TestType>("-true", "(- true)", options);
+    expect_parsed_as<TestType>("10 ^ 100000", "(^ 10 100000)", options);
+    // Nothing is folded by default
+    expect_parsed_as<TestType>("1 + 2", "(+ 1 2)");
+}
+
+template <typename TModule>
+TModule parse_sharing_subtrees(const std::string& s, bool fold_constants = false) {
+    auto tokens = lexer::tokenize(s, error_ignorer);
+    parse_options options;
+    options.share_identical_subtrees = true;
+    options.fold_constants = fold_constants;
+    return parse<TModule>(tokens, error_ignorer, options);
+}
+
+TEMPLATE_TEST_CASE("Share identical subtrees when asked to", "", ast::module, flat_ast::module) {
+    auto shared = parse_sharing_subtrees<TestType>("(f + 1) * (f + 1) [f + 1, [x], [x]] f + 2 \"s\" \"s\"");
+    REQUIRE(shared.expressions.size() == 5);
+    auto product = node_as<ast::multiplication>(shared, shared.expressions[0]);
+    REQUIRE(product.lhs == product.rhs);
+    auto sum = node_as<ast::group>(shared, product.lhs).inside;
+    auto contents = node_as<ast::list>(shared, shared.expressions[1]).contents;
+    REQUIRE(contents[0] == sum);
+    REQUIRE(contents[1] == contents[2]);
+    auto other_sum = shared.expressions[2];
+    REQUIRE(other_sum != sum);
+    REQUIRE(node_as<ast::addition>(shared, other_sum).lhs == node_as<ast::addition>(shared, sum).lhs);
+    REQUIRE(shared.expressions[3] == shared.expressions[4]);
+
+    // Folding -0 mustn't turn it into 0
+    auto signed_zeros = parse_sharing_subtrees<TestType>("-0 * x 0 * x", true);
+    REQUIRE(signed_zeros.expressions[0] != signed_zeros.expressions[1]);
+
+    auto tokens = lexer::tokenize("(f + 1) * (f + 1)", error_ignorer);
+    auto unshared = parse<TestType>(tokens);
+    auto unshared_product = node_as<ast::multiplication>(unshared, unshared.expressions[0]);
+    REQUIRE(unshared_product.lhs != unshared_product.rhs);
+}
+
+TEMPLATE_TEST_CASE("Report tokens that can't start an expression", "", ast::module, flat_ast::module) {
+    struct counting_reporter : public errors::reporter_interface {
+        std::vector<std::string> near_lexemes;
+        std::vector<int> columns;
+        void report(errors::error_type type, std::string_view near_lexeme, int, int column) override {
+            REQUIRE(type == errors::error_type::UNEXPECTED_TOKEN);
+            near_lexemes.emplace_back(near_lexeme);
+            columns.push_back(column);
+        }
+    } reporter;
+    auto tokens = lexer::tokenize("1 + ) 2", error_ignorer);
+    auto parse_tree = parse<TestType>(tokens, reporter);
+    REQUIRE(reporter.near_lexemes == std::vector<std::string>{")"});
+    REQUIRE(reporter.columns == std::vector<int>{5});
+    REQUIRE(parse_tree.expressions.size() == 2);
+    REQUIRE(to_sexpression(parse_tree, parse_tree.expressions.front()) == "(+ 1 nil)");
+
+    auto unfinished = lexer::tokenize("1 +", error_ignorer);
+    parse_tree = parse<TestType>(unfinished, reporter);
+    REQUIRE(reporter.near_lexemes.size() == 2);
+    REQUIRE(to_sexpression(parse_tree, parse_tree.expressions.front()) == "(+ 1 nil)");
+}
+
+TEMPLATE_TEST_CASE("Report groups and lists that aren't closed", "", ast::module, flat_ast::module) {
+    struct recording_reporter : public errors::reporter_interface {
+        std::vector<std::string> near_lexemes;
+        void report(errors::error_type type, std::string_view near_lexeme, int, int) override {
+            REQUIRE(type == errors::error_type::UNEXPECTED_TOKEN);
+            near_lexemes.emplace_back(near_lexeme);
+        }
+    } reporter;
+    auto unclosed_group = lexer::tokenize("(1", error_ignorer);
+    auto parse_tree = parse<TestType>(unclosed_group, reporter);
+    REQUIRE(reporter.near_lexemes == std::vector<std::string>{""});
+    REQUIRE(to_sexpression(parse_tree, parse_tree.expressions.front()) == "(group 1)");
+
+    reporter.near_lexemes.clear();
+    auto unclosed_list = lexer::tokenize("[x, 2", error_ignorer);
+    parse_tree = parse<TestType>(unclosed_list, reporter);
+    REQUIRE(reporter.near_lexemes == std::vector<std::string>{""});
+    REQUIRE(to_sexpression(parse_tree, parse_tree.expressions.front()) == "[x 2]");
+
+    // The list ends where the comma is missing
+    reporter.near_lexemes.clear();
+    auto missing_comma = lexer::tokenize("[x 2]", error_ignorer);
+    parse_tree = parse<TestType>(missing_comma, reporter);
+    REQUIRE(reporter.near_lexemes == std::vector<std::string>{"2", "]"});
+    REQUIRE(to_sexpression(parse_tree, parse_tree.expressions.front()) == "[x]");
+}
+
+TEMPLATE_TEST_CASE("Parse nesting far deeper than the native stack allows", "", ast::module, flat_ast::module) {
+    const size_t depth = 1 << 18;
+    std::string source;
+    for (size_t i = 0; i < depth; i++) source += i % 3 == 0 ? "(" : i % 3 == 1 ? "[" : "-";
+    source += "1";
+    for (size_t i = depth; i-- > 0;) {
+        if (i % 3 == 0) source += ")";
+        if (i % 3 == 1) source += "]";
+    }
+    auto tokens = lexer::tokenize(source, error_ignorer);
+    auto parse_tree = parse<TestType>(tokens);
+    REQUIRE(parse_tree.expressions.size() == 1);
+    // Walk down without recursing
+    auto expression = parse_tree.expressions.front();
+    for (size_t i = 0; i < depth; i++) {
+        if (i % 3 == 0) {
+            REQUIRE(holds_node<ast::group>(parse_tree, expression));
+            expression = node_as<ast::group>(parse_tree, expression).inside;
+        } else if (i % 3 == 1) {
+            REQUIRE(holds_node<ast::list>(parse_tree, expression));
+            auto contents = node_as<ast::list>(parse_tree, expression).contents;
+            REQUIRE(contents.size() == 1);
+            expression = contents.front();
+        } else {
+            REQUIRE(holds_node<ast::arithmetic_negation>(parse_tree, expression));
+            expression = node_as<ast::arithmetic_negation>(parse_tree, expression).inside;
+        }
+    }
+    REQUIRE(node_as<ast::number>(parse_tree, expression).value == 1);
+}
+
+TEMPLATE_TEST_CASE("Report nesting deeper than the limit", "", ast::module, flat_ast::module) {
+    struct recording_reporter : public errors::reporter_interface {
+        std::vector<errors::error_type> error_types;
+        void report(errors::error_type type, std::string_view, int, int) override {
+            error_types.push_back(type);
+        }
+    } reporter;
+    parse_options options;
+    options.max_depth = 4;
+    auto shallow = lexer::tokenize("[(1 + -2)] ((([x])))", error_ignorer);
+    auto deep = lexer::tokenize("[1, x] (((((1))))) [3]", error_ignorer);
+    auto shallow_tree = parse<TestType>(shallow, reporter, options);
+    REQUIRE(reporter.error_types.empty());
+    auto deep_tree = parse<TestType>(deep, reporter, options);
+    REQUIRE(shallow_tree.expressions.size() == 2);
+    REQUIRE(reporter.error_types == std::vector<errors::error_type>{errors::error_type::NESTING_TOO_DEEP});
+    // Everything after the error is skipped
+    REQUIRE(deep_tree.expressions.size() == 2);
+    REQUIRE(holds_node<ast::list>(deep_tree, deep_tree.expressions[0]));
+    REQUIRE(holds_node<ast::nil>(deep_tree, deep_tree.expressions[1]));
+
+    // Lists of literals are too deep whether or not they're folded
+    auto nested_literals = lexer::tokenize("[[1]]", error_ignorer);
+    options.max_depth = 1;
+    for (bool fold : {false, true}) {
+        options.fold_literal_lists = fold;
+        reporter.error_types.clear();
+        parse<TestType>(nested_literals, reporter, options);
+        REQUIRE(reporter.error_types == std::vector<errors::error_type>{errors::error_type::NESTING_TOO_DEEP});
+    }
+}
+
+TEST_CASE("Parse big lists on several threads exactly as on one") {
+    struct recording_reporter : public errors::reporter_interface {
+        std::vector<std::string> near_lexemes;
+        void report(errors::error_type, std::string_view near_lexeme, int, int) override {
+            near_lexemes.emplace_back(near_lexeme);
+        }
+    };
+    static const char* const elements[] = {
+        "1", "x + 2 * y", "[3, [4, 5], []]", "(6 : xs)", "-a ^ 2", "[[7], (8 - 9)]", "not b or c"
+    };
+    std::string well_formed = "[";
+    for (int i = 0; i < 2000; i++) {
+        if (i > 0) well_formed += ", ";
+        well_formed += elements[i % std::size(elements)];
+    }
+    well_formed += "] 10";
+    // Errors partway through have to be recovered from as they would be serially
+    std::string unexpected_token = well_formed;
+    unexpected_token.replace(unexpected_token.find("(6 : xs)", 5000), 8, "(6 : *)");
+    std::string missing_comma = well_formed;
+    missing_comma.replace(missing_comma.find("[3, [4, 5], []]", 5000), 15, "[3, [4, 5] []]");
+    std::string trailing_comma = "[" + well_formed + ",]";
+    // Lists around one with an error are only tried in parallel once
+    std::string nested_error = unexpected_token.substr(0, unexpected_token.size() - 3);
+    for (int i = 0; i < 50; i++) nested_error = "[" + nested_error + ", [x], y]";
+    // A list of one element has nothing to split
+    std::string one_element = "[" + well_formed.substr(0, well_formed.size() - 3) + "]";
+    // Only folded into a constant once every element has been
+    std::string grouped_literals = "[";
+    for (int i = 0; i < 500; i++) grouped_literals += (i > 0 ? ", (-" : "(-") + std::to_string(i) + ")";
+    grouped_literals += "]";
+    // Giving up partway through skips everything after it, list or not
+    std::string too_deep = well_formed;
+    too_deep.replace(too_deep.find("(6 : xs)", 5000), 8, std::string(100, '(') + "6" + std::string(100, ')'));
+    // Each big list gets the same threads
+    std::string several_lists = well_formed + " " + unexpected_token + " " + well_formed;
+
+    for (const std::string& source : {well_formed, unexpected_token, missing_comma, trailing_comma, nested_error,
+                                      one_element, grouped_literals, too_deep, several_lists}) {
+        auto tokens = lexer::tokenize(source, error_ignorer);
+        for (bool fold_constants : {false, true}) {
+            parse_options serial;
+            serial.thread_count = 1;
+            serial.fold_constants = fold_constants;
+            serial.max_depth = 64;
+            parse_options parallel = serial;
+            parallel.thread_count = 4;
+            parallel.min_parallel_list_tokens = 16;
+            recording_reporter serial_errors, parallel_errors;
+            auto serial_tree = create_ast(tokens, serial_errors, serial);
+            auto parallel_tree = create_ast(tokens, parallel_errors, parallel);
+            REQUIRE(parallel_tree.expressions.size() == serial_tree.expressions.size());
+            for (size_t i = 0; i < serial_tree.expressions.size(); i++) {
+                REQUIRE(to_sexpression(parallel_tree, parallel_tree.expressions[i]) ==
+                        to_sexpression(serial_tree, serial_tree.expressions[i]));
+            }
+            REQUIRE(parallel_errors.near_lexemes == serial_errors.near_lexemes);
+        }
+    }
+}
+
+TEST_CASE("Share subtrees of big lists with more than one thread as with one") {
+    std::string big_list = "[";
+    for (int i = 0; i < 200; i++) big_list += i > 0 ? ", x + 1" : "x + 1";
+    big_list += "]";
+    std::string source = big_list + " " + big_list + " x + 1";
+    auto tokens = lexer::tokenize(source, error_ignorer);
+    parse_options options;
+    options.share_identical_subtrees = true;
+    options.thread_count = 4;
+    options.min_parallel_list_tokens = 16;
+    auto shared = create_ast(tokens, error_ignorer, options);
+    REQUIRE(shared.expressions.size() == 3);
+    REQUIRE(shared.expressions[0] == shared.expressions[1]);
+    auto contents = node_as<ast::list>(shared, shared.expressions[0]).contents;
+    REQUIRE(contents.front() == contents.back());
+    REQUIRE(contents.front() == shared.expressions[2]);
+}
+
+TEST_CASE("Copy a flat tree as plain arrays") {
+    auto tokens = lexer::tokenize("[1 + 2, -x] \"s\"", error_ignorer);
+    auto original = create_flat_ast(tokens, error_ignorer);
+    flat_ast::module copy = original;
+    original = flat_ast::module();
+    REQUIRE(copy.expressions.size() == 2);
+    auto contents = copy.get<ast::list>(copy.expressions[0]).contents;
+    REQUIRE(copy.kind_at(contents[0]) == flat_ast::kind::addition);
+    REQUIRE(copy.get<ast::number>(copy.get<ast::addition>(contents[0]).rhs).value == 2);
+    REQUIRE(copy.kind_at(copy.get<ast::arithmetic_negation>(contents[1]).inside) == flat_ast::kind::identifier);
+    REQUIRE(copy.get<ast::string>(copy.expressions[1]).value == "s");
+    // Children always come before their parents
+    for (flat_ast::node_index i = 0; i < copy.nodes.size(); i++) {
+        if (copy.is<ast::addition>(i)) REQUIRE(copy.get<ast::addition>(i).lhs < i);
+    }
 }
 
 // should reject [1,2,3,]
 // test unclosed parenthesis
-// nest existing operators
 // nest list expressions
 // identifier 123abc should cause error
 // reject leading and trailing dot
-// test all operator precedences
@@ -0,0 +1,122 @@
+#include "scanner.hpp"
+
+#include "third-party/catch.hpp"
+
+#include <random>
+#include <string>
+
+using namespace pierogi::scanner;
+
+// Builds a run of `length` bytes drawn from `alphabet` followed by `stop`, so
+// the stopping byte crosses every block boundary of the vectorized scanners
+std::string make_run(const std::string& alphabet, size_t length, char stop) {
+    std::string run;
+    for (size_t i = 0; i < length; i++) run += alphabet[(i * 7 + length) % alphabet.size()];
+    run += stop;
+    return run;
+}
+
+TEST_CASE("Scalar scanners stop at the right bytes") {
+    const scanners& scalar = scanners_for(instruction_set::SCALAR);
+    std::string s = "abc_123 rest";
+    REQUIRE(scalar.skip_identifier(s.data(), s.data() + s.size()) == s.data() + 7);
+    s = " \t\n\r\n x";
+    REQUIRE(scalar.skip_whitespace(s.data(), s.data() + s.size()) == s.data() + 6);
+    s = "comment\nnext";
+    REQUIRE(scalar.find_line_end(s.data(), s.data() + s.size()) == s.data() + 7);
+    s = "multi\nline\" after";
+    REQUIRE(scalar.find_string_end(s.data(), s.data() + s.size()) == s.data() + 10);
+}
+
+TEST_CASE("Vectorized scanners agree with the scalar scanners") {
+    const scanners& scalar = scanners_for(instruction_set::SCALAR);
+    for (instruction_set set : supported_instruction_sets()) {
+        const scanners& vectorized = scanners_for(set);
+        for (size_t length = 0; length < 100; length++) {
+            for (char stop : {' ', '"', '\n', '@', '\xC3', 'a'}) {
+                std::string s = make_run("abcXYZ_0189", length, stop);
+                const char* begin = s.data();
+                const char* end = s.data() + s.size();
+                REQUIRE(vectorized.skip_identifier(begin, end) == scalar.skip_identifier(begin, end));
+
+                s = make_run(" \t\r\n", length, stop);
+                begin = s.data();
+                end = s.data() + s.size();
+                REQUIRE(vectorized.skip_whitespace(begin, end) == scalar.skip_whitespace(begin, end));
+
+                s = make_run("text \n#[]", length, stop);
+                begin = s.data();
+                end = s.data() + s.size();
+                REQUIRE(vectorized.find_line_end(begin, end) == scalar.find_line_end(begin, end));
+                REQUIRE(vectorized.find_string_end(begin, end) == scalar.find_string_end(begin, end));
+                REQUIRE(vectorized.find_non_ascii(begin, end) == scalar.find_non_ascii(begin, end));
+            }
+        }
+    }
+}
+
+const char* first_invalid_byte(const scanners& scan, const std::string& s) {
+    return scan.validate_utf8(s.data(), s.data() + s.size());
+}
+
+TEST_CASE("Scalar UTF-8 validation stops at the first invalid sequence") {
+    const scanners& scalar = scanners_for(instruction_set::SCALAR);
+    std::string s = "plain ascii";
+    REQUIRE(first_invalid_byte(scalar, s) == s.data() + s.size());
+    s = "gr\xC3\xB6\xC3\x9F" "e \xE6\x97\xA5 \xF0\x9F\x98\x80";
+    REQUIRE(first_invalid_byte(scalar, s) == s.data() + s.size());
+    for (const char* invalid : {"\x80", "\xC0\xAF", "\xC3", "\xE0\x80\x80", "\xED\xA0\x80",
+                                "\xF4\x90\x80\x80", "\xF8\x88\x80\x80\x80", "\xFF", "\xE6\x97"}) {
+        s = std::string("ok ") + invalid + " after";
+        INFO(s);
+        REQUIRE(first_invalid_byte(scalar, s) == s.data() + 3);
+    }
+}
+
+// Random text made of valid and invalid sequences of every length, so errors
+// land at every position relative to the vectorized blocks
+std::string make_mixed_utf8(std::mt19937& generator, size_t size, bool allow_invalid) {
+    static const char* const valid[] = {
+        "a", " ", "\xC3\xA9", "\xCE\xA3", "\xE6\x97\xA5", "\xED\x9F\xBF", "\xEF\xBF\xBD",
+        "\xF0\x9F\x98\x80", "\xF4\x8F\xBF\xBF", "0123456789abcdef0123456789abcdef"
+    };
+    static const char* const invalid[] = {
+        "\x80", "\xBF", "\xC0\x80", "\xC1\xBF", "\xC3", "\xE0\x9F\xBF", "\xED\xA0\x80",
+        "\xF0\x8F\xBF\xBF", "\xF4\x90\x80\x80", "\xF5\x80\x80\x80", "\xFE", "\xFF", "\xE6\x97"
+    };
+    std::uniform_int_distribution<size_t> valid_piece(0, std::size(valid) - 1);
+    std::uniform_int_distribution<size_t> invalid_piece(0, std::size(invalid) - 1);
+    std::uniform_int_distribution<int> percent(0, 99);
+    std::string s;
+    while (s.size() < size) {
+        s += allow_invalid && percent(generator) == 0 ? invalid[invalid_piece(generator)] : valid[valid_piece(generator)];
+    }
+    return s;
+}
+
+TEST_CASE("Vectorized UTF-8 validation agrees with the scalar validation") {
+    const scanners& scalar = scanners_for(instruction_set::SCALAR);
+    std::mt19937 generator(2024);
+    for (instruction_set set : supported_instruction_sets()) {
+        const scanners& vectorized = scanners_for(set);
+        for (int i = 0; i < 2000; i++) {
+            std::string s = make_mixed_utf8(generator, i % 300, i % 2 == 0);
+            REQUIRE(first_invalid_byte(vectorized, s) == first_invalid_byte(scalar, s));
+            REQUIRE(vectorized.find_non_ascii(s.data(), s.data() + s.size()) ==
+                    scalar.find_non_ascii(s.data(), s.data() + s.size()));
+        }
+        // Sequences cut short right before a block of pure ASCII
+        for (const char* invalid : {"\xC3", "\xE6\x97", "\xF0\x9F\x98"}) {
+            for (size_t prefix = 0; prefix < 70; prefix++) {
+                std::string s = std::string(prefix, 'a') + invalid + std::string(70, 'b');
+                REQUIRE(first_invalid_byte(vectorized, s) == s.data() + prefix);
+            }
+        }
+        std::uniform_int_distribution<int> byte(0, 255);
+        for (int i = 0; i < 2000; i++) {
+            std::string s(i % 100, '\0');
+            for (char& c : s) c = static_cast<char>(byte(generator) | (i % 3 == 0 ? 0x80 : 0));
+            REQUIRE(first_invalid_byte(vectorized, s) == first_invalid_byte(scalar, s));
+        }
+    }
+}
@@ -0,0 +1,64 @@
+#include "source.hpp"
+
+#include "third-party/catch.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+
+using namespace pierogi;
+
+std::filesystem::path write_temporary_file(const std::string& name, const std::string& contents) {
+    auto path = std::filesystem::temp_directory_path() / name;
+    std::ofstream file(path, std::ios::binary);
+    file << contents;
+    return path;
+}
+
+TEST_CASE("Map a file's contents") {
+    const std::string contents = "x = [1, 2, 3]\n# comment\n";
+    auto path = write_temporary_file("pierogi_source_test.prgi", contents);
+    source::mapped_file file(path);
+    REQUIRE(file.contents() == contents);
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Map an empty file") {
+    auto path = write_temporary_file("pierogi_empty_source_test.prgi", "");
+    source::mapped_file file(path);
+    REQUIRE(file.contents().empty());
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Throw when mapping a missing file") {
+    REQUIRE_THROWS_AS(source::mapped_file("/nonexistent/pierogi/source.prgi"), std::system_error);
+}
+
+TEST_CASE("Locate offsets by line and column") {
+    const std::string text = "x = 1\n\n  y = \"a\nb\"\n";
+    source::line_index lines(text);
+    REQUIRE(lines.line_count() == 5);
+    auto first = lines.locate(0);
+    REQUIRE(first.line == 1);
+    REQUIRE(first.column == 1);
+    auto newline = lines.locate(5);
+    REQUIRE(newline.line == 1);
+    REQUIRE(newline.column == 6);
+    auto blank = lines.locate(6);
+    REQUIRE(blank.line == 2);
+    REQUIRE(blank.column == 1);
+    auto y = lines.locate(text.find('y'));
+    REQUIRE(y.line == 3);
+    REQUIRE(y.column == 3);
+    auto b = lines.locate(text.find('b'));
+    REQUIRE(b.line == 4);
+    REQUIRE(b.column == 1);
+    REQUIRE(lines.locate(text.size()).line == 5);
+}
+
+TEST_CASE("Index a source without newlines") {
+    source::line_index lines("");
+    REQUIRE(lines.line_count() == 1);
+    REQUIRE(lines.locate(0).line == 1);
+    REQUIRE(lines.locate(0).column == 1);
+}
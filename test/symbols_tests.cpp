@@ -0,0 +1,50 @@
+#include "symbols.hpp"
+
+#include "third-party/catch.hpp"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace pierogi;
+
+TEST_CASE("Intern each distinct name once") {
+    symbols::symbol_table table;
+    auto x = table.intern("x");
+    auto total = table.intern("total");
+    REQUIRE(x != total);
+    REQUIRE(table.intern("x") == x);
+    REQUIRE(table.intern(std::string("tot") + "al") == total);
+    REQUIRE(table.size() == 2);
+    REQUIRE(table.name(x) == "x");
+    REQUIRE(table.name(total) == "total");
+}
+
+TEST_CASE("Keep interned names valid as the arena grows") {
+    symbols::symbol_table table;
+    std::vector<std::string_view> first_names;
+    for (int i = 0; i < 20000; i++) {
+        auto id = table.intern("name_" + std::to_string(i));
+        if (i < 10) first_names.push_back(table.name(id));
+    }
+    const std::string long_name(100000, 'a');
+    auto long_id = table.intern(long_name);
+    table.intern("after_long_name");
+    REQUIRE(table.name(long_id) == long_name);
+    for (int i = 0; i < 10; i++) REQUIRE(first_names[i] == "name_" + std::to_string(i));
+}
+
+TEST_CASE("Intern from several threads at once") {
+    symbols::symbol_table table;
+    std::vector<std::vector<symbols::symbol_id>> ids(4);
+    std::vector<std::thread> threads;
+    for (auto& thread_ids : ids) {
+        threads.emplace_back([&table, &thread_ids] {
+            for (int i = 0; i < 1000; i++) thread_ids.push_back(table.intern("name_" + std::to_string(i)));
+        });
+    }
+    for (std::thread& thread : threads) thread.join();
+    REQUIRE(table.size() == 1000);
+    for (const auto& thread_ids : ids) REQUIRE(thread_ids == ids.front());
+    for (int i = 0; i < 1000; i++) REQUIRE(table.name(ids.front()[i]) == "name_" + std::to_string(i));
+}
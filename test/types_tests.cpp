@@ -0,0 +1,23 @@
+#include "types.hpp"
+
+#include "third-party/catch.hpp"
+
+#include <vector>
+
+using namespace pierogi;
+
+TEST_CASE("Pack lists of nothing but numbers") {
+    types::list numbers{types::number(1), types::number(2), types::number(3)};
+    REQUIRE(numbers.packed());
+    REQUIRE(numbers.size() == 3);
+    REQUIRE(numbers.numbers() == std::vector<types::number>{1, 2, 3});
+    REQUIRE(std::get<types::number>(numbers.elements()[1]) == 2);
+
+    types::list mixed(std::vector<types::value>{types::number(1), types::string("two")});
+    REQUIRE_FALSE(mixed.packed());
+    REQUIRE(mixed.size() == 2);
+    REQUIRE(std::get<types::string>(mixed.elements()[1]) == "two");
+
+    REQUIRE_FALSE(types::list(std::vector<types::value>{}).packed());
+    REQUIRE(types::list(std::vector<types::number>{}).size() == 0);
+}
@@ -0,0 +1,46 @@
+#include "unicode.hpp"
+
+#include "third-party/catch.hpp"
+
+#include <string>
+
+using namespace pierogi;
+
+unicode::decoded_code_point decode(const std::string& s) {
+    return unicode::decode(s.data(), s.data() + s.size());
+}
+
+TEST_CASE("Decode UTF-8 sequences") {
+    REQUIRE(decode("a").code_point == 'a');
+    REQUIRE(decode("a").length == 1);
+    REQUIRE(decode("\xC3\xA9").code_point == 0xE9);
+    REQUIRE(decode("\xC3\xA9").length == 2);
+    REQUIRE(decode("\xE6\x97\xA5").code_point == 0x65E5);
+    REQUIRE(decode("\xE6\x97\xA5").length == 3);
+    REQUIRE(decode("\xF0\x9F\x98\x80").code_point == 0x1F600);
+    REQUIRE(decode("\xF0\x9F\x98\x80").length == 4);
+}
+
+TEST_CASE("Reject invalid UTF-8 sequences") {
+    REQUIRE(decode("\x80").length == 0);               // Stray continuation byte
+    REQUIRE(decode("\xC3").length == 0);               // Cut short
+    REQUIRE(decode("\xC3" "a").length == 0);           // Missing continuation byte
+    REQUIRE(decode("\xC0\xAF").length == 0);           // Overlong '/'
+    REQUIRE(decode("\xE0\x80\x80").length == 0);       // Overlong U+0000
+    REQUIRE(decode("\xED\xA0\x80").length == 0);       // Surrogate
+    REQUIRE(decode("\xF4\x90\x80\x80").length == 0);   // Past U+10FFFF
+    REQUIRE(decode("\xFF").length == 0);
+}
+
+TEST_CASE("Recognize letters") {
+    REQUIRE(unicode::is_letter('x'));
+    REQUIRE(unicode::is_letter(0xE9));     // é
+    REQUIRE(unicode::is_letter(0x3C0));    // π
+    REQUIRE(unicode::is_letter(0x436));    // ж
+    REQUIRE(unicode::is_letter(0x65E5));   // 日
+    REQUIRE(unicode::is_letter(0xD55C));   // 한
+    REQUIRE_FALSE(unicode::is_letter('1'));
+    REQUIRE_FALSE(unicode::is_letter(0xD7));    // ×
+    REQUIRE_FALSE(unicode::is_letter(0x2211));  // ∑
+    REQUIRE_FALSE(unicode::is_letter(0x1F600)); // 😀
+}